@@ -43,6 +43,31 @@ def get_random_args(random_args, fixed_args):
     else:
         return sample
 
+# Options shared by both sorters. The alltoall routines 3-5 and hash functions other than
+# xxhash64 require a target built with CLI_ENABLE_ALLTOALL and CLI_ENABLE_BLOOMFILTER_HASH.
+def get_random_options(args):
+    options = []
+    local_sorter = random.randint(0, 3)
+    options.append(f"--local-sorter {local_sorter}")
+    if local_sorter == 3:
+        options.append(f"--local-sort-threads {random.randint(1, 2)}")
+    if random.randint(0, 1) == 0:
+        options.append("--detect-presorted")
+
+    if random.randint(0, 3) == 0:
+        options.append("--exact-splitting")
+    if random.randint(0, 3) == 0:
+        options.append(f"--max-imbalance {random.uniform(0.01, 0.5)}")
+    if random.randint(0, 1) == 0:
+        options.append(f"--sampler-seed {random.randint(0, 2**32)}")
+
+    options.append(f"--alltoall {random.choice([0, 3, 4, 5])}")
+    if "--prefix-doubling" in args:
+        options.append(f"--bloomfilter-hash {random.randint(0, 3)}")
+        if random.randint(0, 1) == 0:
+            options.append(f"--bloomfilter-tail {random.randint(0, 100)}")
+    return options
+
 def fuzz_merge_sort(target, fixed_args, min_procs, max_procs, repeat):
     for _ in repeat:
         random_args = common_args
@@ -58,6 +83,35 @@ def fuzz_merge_sort(target, fixed_args, min_procs, max_procs, repeat):
         dn_ratio = random.random()
         sampling_factor = random.randint(1, 10)
 
+        args += get_random_options(args + fixed_args)
+        args.append(f"--rebalance {random.randint(0, 2)}")
+
+        # mutually exclusive options, see `SorterArgs::validate`
+        if "--prefix-doubling" in args + fixed_args:
+            if random.randint(0, 1) == 0:
+                args.append("--compact-prefixes")
+
+            # names and delivered strings require the simple permutation
+            match random.randint(0, 2):
+                case 1:
+                    args.append("--names")
+                    permutation = 0
+                case 2:
+                    args.append("--deliver-strings")
+                    permutation = 0
+        else:
+            match random.randint(0, 3):
+                case 1:
+                    args.append(f"--insert-batches {random.randint(1, 4)}")
+                case 2:
+                    args.append(f"--merge-sequences {random.randint(2, 4)}")
+                case 3:
+                    args.append("--names")
+
+            no_overlap = {"--sample-indexed", "--exact-splitting"}
+            if not no_overlap & set(args + fixed_args) and random.randint(0, 1) == 0:
+                args.append("--overlap-splitters")
+
         run_or_exit(f"mpirun -n {procs} --oversubscribe"
               f" target/{target}/distributed_sorter -v -V -i 5 --permutation {permutation}"
               f" --redistribution {redistribution} --num-strings {num_strings}"
@@ -101,6 +155,14 @@ def fuzz_space_efficient_sort(target, fixed_args, min_procs, max_procs, repeat):
         sampling_factor = random.randint(1, 10)
         quantile_factor = random.randint(1, 10)
 
+        # small quantiles ensure that the inverse permutation spans multiple quantiles
+        if permutation == 0 and random.randint(0, 1) == 0:
+            args.append("--inverse-permutation")
+        if permutation != 0 and random.randint(0, 1) == 0:
+            args.append("--permutation-compression")
+
+        args += get_random_options(args + fixed_args)
+
         run_or_exit(f"mpirun -n {procs} --oversubscribe"
             f" target/{target}/space_efficient_sorter -v -V -i 3 --permutation {permutation}"
             f" --redistribution {redistribution} --sampling-factor {sampling_factor}"
@@ -25,13 +25,17 @@
 #include "sorter/distributed/prefix_doubling.hpp"
 #include "sorter/distributed/redistribution.hpp"
 #include "sorter/distributed/sample.hpp"
+#include "sorter/local/local_sort.hpp"
 #include "strings/stringset.hpp"
 
 inline void check_path_exists(std::string const& path) {
     tlx_die_verbose_unless(std::filesystem::exists(path), "file not found: " << path);
 };
 
-enum class MPIRoutineAllToAll { native = 0, direct, combined, sentinel };
+// clang-format off
+enum class MPIRoutineAllToAll { native = 0, direct, combined, node_aggregated, rma, neighbor,
+                                sentinel };
+// clang-format on
 
 // clang-format off
 enum class Redistribution { none = 0, naive, simple_strings, simple_chars,
@@ -40,6 +44,13 @@ enum class Redistribution { none = 0, naive, simple_strings, simple_chars,
 
 enum class SplitterSorter { RQuickV1, RQuickV2, RQuickLcp, Sequential };
 
+enum class BloomFilterHash { xxhash64 = 0, xxhash32, siphash, crc32c, sentinel };
+
+// clang-format off
+enum class LocalSorter { radix_sort = 0, multikey_quicksort, lcp_merge_sort,
+                         parallel_sample_sort, sentinel };
+// clang-format on
+
 template <typename T>
 T clamp_enum_value(size_t const i) {
     return static_cast<T>(std::min(i, static_cast<size_t>(T::sentinel)));
@@ -50,11 +61,22 @@ struct SamplerArgs {
     bool sample_indexed = false;
     bool sample_random = false;
     size_t sampling_factor = 2;
+    double max_imbalance = 0.0;
+    size_t seed = dss_mehnert::sample::SamplingConfig{}.seed;
+    bool exact_splitting = false;
+
+    dss_mehnert::sample::SamplingConfig get_config() const {
+        return {sampling_factor, max_imbalance, seed};
+    }
 };
 
 struct CommonArgs {
     std::string experiment;
     size_t alltoall_routine = static_cast<size_t>(MPIRoutineAllToAll::native);
+    size_t local_sorter = static_cast<size_t>(LocalSorter::radix_sort);
+    size_t local_sort_memory = 0;
+    size_t local_sort_threads = 1;
+    bool detect_presorted = false;
     SamplerArgs sampler;
     bool rquick_v1 = false;
     bool rquick_lcp = false;
@@ -64,30 +86,85 @@ struct CommonArgs {
     bool lcp_compression = false;
     bool prefix_doubling = false;
     bool grid_bloomfilter = true;
+    size_t bloomfilter_tail = 0;
+    size_t bloomfilter_hash = static_cast<size_t>(BloomFilterHash::xxhash64);
     size_t num_iterations = 5;
     bool check_sorted = false;
     bool check_complete = false;
     bool verbose = false;
     bool count_prefixes = false;
+    bool progress_thread = false;
 
     std::string get_prefix(dss_mehnert::Communicator const& comm) const {
         // clang-format off
         return std::string("RESULT")
                + (experiment.empty() ? "" : (" experiment=" + experiment))
                + " num_procs="          + std::to_string(comm.size())
+               + " local_sorter="       + std::string(get_local_sorter().get_name())
+               + " local_sort_threads=" + std::to_string(local_sort_threads)
+               + " detect_presorted="   + std::to_string(detect_presorted)
                + " sample_chars="       + std::to_string(sampler.sample_chars)
                + " sample_indexed="     + std::to_string(sampler.sample_indexed)
                + " sample_random="      + std::to_string(sampler.sample_random)
                + " sampling_factor="    + std::to_string(sampler.sampling_factor)
+               + " max_imbalance="      + std::to_string(sampler.max_imbalance)
+               + " sampler_seed="       + std::to_string(sampler.seed)
+               + " exact_splitting="    + std::to_string(sampler.exact_splitting)
                + " rquick_v1="          + std::to_string(rquick_v1)
                + " rquick_lcp="         + std::to_string(rquick_lcp)
                + " lcp_compression="    + std::to_string(lcp_compression)
                + " prefix_compression=" + std::to_string(prefix_compression)
                + " prefix_doubling="    + std::to_string(prefix_doubling)
-               + " grid_bloomfilter="   + std::to_string(grid_bloomfilter);
+               + " grid_bloomfilter="   + std::to_string(grid_bloomfilter)
+               + " bloomfilter_tail="   + std::to_string(bloomfilter_tail)
+               + " bloomfilter_hash="   + std::string(get_name(get_hash_kind()))
+               + " progress_thread="    + std::to_string(progress_thread);
         // clang-format on
     }
 
+    dss_mehnert::local_sort::LocalSorter get_local_sorter() const {
+        using dss_mehnert::local_sort::LocalSortKind;
+
+        auto const make_sorter = [&](LocalSortKind const kind) {
+            return dss_mehnert::local_sort::LocalSorter{kind,
+                                                        local_sort_memory,
+                                                        detect_presorted,
+                                                        local_sort_threads};
+        };
+
+        switch (clamp_enum_value<LocalSorter>(local_sorter)) {
+            case LocalSorter::radix_sort:
+                return make_sorter(LocalSortKind::radix_sort);
+            case LocalSorter::multikey_quicksort:
+                return make_sorter(LocalSortKind::multikey_quicksort);
+            case LocalSorter::lcp_merge_sort:
+                return make_sorter(LocalSortKind::lcp_merge_sort);
+            case LocalSorter::parallel_sample_sort:
+                return make_sorter(LocalSortKind::parallel_sample_sort);
+            case LocalSorter::sentinel:
+                break;
+        }
+        tlx_die("unknown local sorter");
+    }
+
+    dss_mehnert::bloomfilter::HashKind get_hash_kind() const {
+        using dss_mehnert::bloomfilter::HashKind;
+
+        switch (clamp_enum_value<BloomFilterHash>(bloomfilter_hash)) {
+            case BloomFilterHash::xxhash64:
+                return HashKind::xxhash64;
+            case BloomFilterHash::xxhash32:
+                return HashKind::xxhash32;
+            case BloomFilterHash::siphash:
+                return HashKind::siphash;
+            case BloomFilterHash::crc32c:
+                return HashKind::crc32c;
+            case BloomFilterHash::sentinel:
+                break;
+        }
+        tlx_die("unknown hash function");
+    }
+
     SplitterSorter get_splitter_sorter() const {
         tlx_die_verbose_if(rquick_v1 && rquick_lcp, "RQuick v1 does not support using LCP values");
         tlx_die_verbose_if(splitter_sequential && (rquick_v1 || rquick_lcp),
@@ -129,10 +206,32 @@ template <typename Callback, typename... Args>
 void dispatch_bloomfilter(Callback cb, CommonArgs const& args) {
     using namespace dss_mehnert::bloomfilter;
 
-    if (args.grid_bloomfilter) {
-        cb.template operator()<Args..., MultiLevel<true, XXHasher>>();
+    auto dispatch_filter = [&]<typename HashPolicy>() {
+        if (args.grid_bloomfilter) {
+            cb.template operator()<Args..., MultiLevel<true, HashPolicy>>();
+        } else {
+            cb.template operator()<Args..., SingleLevel<true, HashPolicy>>();
+        }
+    };
+
+    auto const hash_kind = args.get_hash_kind();
+    if constexpr (CliOptions::enable_bloomfilter_hash) {
+        switch (hash_kind) {
+            case HashKind::xxhash64:
+                return dispatch_filter.template operator()<XXHasher>();
+            case HashKind::xxhash32:
+                return dispatch_filter.template operator()<XXHasher32>();
+            case HashKind::siphash:
+                return dispatch_filter.template operator()<SipHasher>();
+            case HashKind::crc32c:
+                return dispatch_filter.template operator()<Crc32cHasher>();
+        }
+        tlx_die("unknown hash function");
     } else {
-        cb.template operator()<Args..., SingleLevel<true, XXHasher>>();
+        if (hash_kind != HashKind::xxhash64) {
+            die_with_feature("CLI_ENABLE_BLOOMFILTER_HASH");
+        }
+        dispatch_filter.template operator()<XXHasher>();
     }
 }
 
@@ -188,6 +287,30 @@ void dispatch_alltoall_strings(Callback cb, CommonArgs const& args) {
             }
             return;
         }
+        case MPIRoutineAllToAll::node_aggregated: {
+            if constexpr (CliOptions::enable_alltoall) {
+                dispatch_lcp_compression.template operator()<AlltoallKind::node_aggregated>();
+            } else {
+                die_with_feature("CLI_ENABLE_ALLTOALL");
+            }
+            return;
+        }
+        case MPIRoutineAllToAll::rma: {
+            if constexpr (CliOptions::enable_alltoall) {
+                dispatch_lcp_compression.template operator()<AlltoallKind::rma>();
+            } else {
+                die_with_feature("CLI_ENABLE_ALLTOALL");
+            }
+            return;
+        }
+        case MPIRoutineAllToAll::neighbor: {
+            if constexpr (CliOptions::enable_alltoall) {
+                dispatch_lcp_compression.template operator()<AlltoallKind::neighbor>();
+            } else {
+                die_with_feature("CLI_ENABLE_ALLTOALL");
+            }
+            return;
+        }
         case MPIRoutineAllToAll::sentinel: {
             break;
         }
@@ -213,6 +336,13 @@ inline void add_common_args(CommonArgs& args, tlx::CmdlineParser& cp) {
                   "sampling-factor",
                   args.sampler.sampling_factor,
                   "use the given oversampling factor");
+    cp.add_double("max-imbalance",
+                  args.sampler.max_imbalance,
+                  "derive the oversampling factor from the given maximum imbalance");
+    cp.add_size_t("sampler-seed", args.sampler.seed, "base seed of the random samplers");
+    cp.add_flag("exact-splitting",
+                args.sampler.exact_splitting,
+                "compute exactly balanced splitters by multi-sequence selection");
     cp.add_flag('Q', "rquick-v1", args.rquick_v1, "use version 1 of RQuick (defaults to v2)");
     cp.add_flag('L', "rquick-lcp", args.rquick_lcp, "use LCP values in RQuick (only with v2)");
     cp.add_flag("splitter-sequential", args.splitter_sequential, "use sequential splitter sorting");
@@ -229,21 +359,47 @@ inline void add_common_args(CommonArgs& args, tlx::CmdlineParser& cp) {
                 "grid-bloomfilter",
                 args.grid_bloomfilter,
                 "use gridwise bloom filter (requires prefix doubling) [default]");
+    cp.add_size_t("bloomfilter-hash",
+                  args.bloomfilter_hash,
+                  "hash function used by the bloom filter "
+                  "([0]=xxhash64, 1=xxhash32, 2=siphash, 3=crc32c)");
+    cp.add_size_t("bloomfilter-tail",
+                  args.bloomfilter_tail,
+                  "stop prefix doubling once at most this many strings are undecided, "
+                  "these strings are sent in full");
     cp.add_size_t('a',
                   "alltoall",
                   args.alltoall_routine,
                   "All-To-All routine to use during string exchange "
-                  "([0]=native, 1=direct, 2=combined)");
+                  "([0]=native, 1=direct, 2=combined, 3=node-aggregated, 4=rma, "
+                  "5=neighbor)");
     cp.add_size_t('t',
                   "redistribution",
                   args.redistribution,
                   "redistribution scheme to use for multi-level sort "
                   "(0=none, 1=naive, 2=simple-strings, 3=simple-chars, "
                   " 4=det-strings, 5=det-chars, [6]=grid)");
+    cp.add_size_t("local-sorter",
+                  args.local_sorter,
+                  "algorithm used for local sorting "
+                  "([0]=radix-sort, 1=multikey-quicksort, 2=lcp-merge-sort, "
+                  "3=parallel-sample-sort)");
+    cp.add_bytes("local-sort-memory",
+                 args.local_sort_memory,
+                 "memory hint passed to the local sorter (0=unlimited)");
+    cp.add_size_t("local-sort-threads",
+                  args.local_sort_threads,
+                  "number of threads per PE used by parallel sample sort [default: 1]");
+    cp.add_flag("detect-presorted",
+                args.detect_presorted,
+                "detect (nearly) sorted inputs during local sorting");
     cp.add_flag('v', "check-sorted", args.check_sorted, "check that the result is sorted");
     cp.add_flag('V', "check-complete", args.check_complete, "check that the result is complete");
     cp.add_flag("verbose", args.verbose, "print some debug output");
     cp.add_flag("count-prefixes", args.count_prefixes, "count LCPs and dist prefixes");
+    cp.add_flag("progress-thread",
+                args.progress_thread,
+                "poll MPI from a background thread (requires MPI_THREAD_MULTIPLE)");
 }
 
 template <typename Container>
@@ -504,10 +660,14 @@ class PolymorphicPartitionPolicy {
 public:
     using This = PolymorphicPartitionPolicy<StringSet, SamplerArgs...>;
     using StringPtr = tlx::sort_strings_detail::StringLcpPtr<StringSet, size_t>;
+    using Char = StringSet::Char;
 
     template <typename PartitionPolicy>
     explicit PolymorphicPartitionPolicy(PartitionPolicy policy)
-        : self_{new PartitionObject<PartitionPolicy>{std::move(policy)}} {}
+        : splits_ties_{policy.splits_ties()},
+          self_{new PartitionObject<PartitionPolicy>{std::move(policy)}} {}
+
+    bool splits_ties() const { return splits_ties_; }
 
     template <typename SamplerArg>
     std::vector<size_t> compute_partition(StringPtr const& strptr,
@@ -517,6 +677,20 @@ public:
         return self_->compute_partition(strptr, num_partitions, arg, comm);
     }
 
+    template <typename SamplerArg>
+    std::vector<Char> presample(StringSet const& ss,
+                                size_t const num_partitions,
+                                SamplerArg const arg,
+                                Communicator const& comm) const {
+        return self_->presample(ss, num_partitions, arg, comm);
+    }
+
+    std::vector<Char> select_presampled(std::vector<Char>&& sample,
+                                        size_t const num_partitions,
+                                        Communicator const& comm) const {
+        return self_->select_presampled(std::move(sample), num_partitions, comm);
+    }
+
 private:
     template <typename SamplerArg>
     struct PartitionConcept_ {
@@ -526,10 +700,20 @@ private:
                                                       size_t const num_partitions,
                                                       SamplerArg const arg,
                                                       Communicator const& comm) const = 0;
+
+        virtual std::vector<Char> presample(StringSet const& ss,
+                                            size_t const num_partitions,
+                                            SamplerArg const arg,
+                                            Communicator const& comm) const = 0;
     };
 
     struct PartitionConcept : public PartitionConcept_<SamplerArgs>... {
         using PartitionConcept_<SamplerArgs>::compute_partition...;
+        using PartitionConcept_<SamplerArgs>::presample...;
+
+        virtual std::vector<Char> select_presampled(std::vector<Char>&& sample,
+                                                    size_t const num_partitions,
+                                                    Communicator const& comm) const = 0;
     };
 
     template <typename PartitionPolicy, typename SamplerArg>
@@ -540,13 +724,28 @@ private:
                                                       Communicator const& comm) const override {
             return PartitionPolicy::compute_partition(strptr, num_partitions, arg, comm);
         }
+
+        virtual std::vector<Char> presample(StringSet const& ss,
+                                            size_t const num_partitions,
+                                            SamplerArg const arg,
+                                            Communicator const& comm) const override {
+            return PartitionPolicy::presample(ss, num_partitions, arg, comm);
+        }
     };
 
     template <typename PartitionPolicy>
-    struct PartitionObject final : public PartitionObject_<PartitionPolicy, SamplerArgs>... {
+    struct PartitionObject final : public PartitionObject_<PartitionPolicy, SamplerArgs>...,
+                                   private virtual PartitionPolicy {
         explicit PartitionObject(PartitionPolicy policy) : PartitionPolicy{std::move(policy)} {}
+
+        virtual std::vector<Char> select_presampled(std::vector<Char>&& sample,
+                                                    size_t const num_partitions,
+                                                    Communicator const& comm) const override {
+            return PartitionPolicy::select_presampled(std::move(sample), num_partitions, comm);
+        }
     };
 
+    bool splits_ties_;
     std::unique_ptr<PartitionConcept> self_;
 };
 
@@ -569,11 +768,21 @@ using SpaceEfficientPartitionPolicy = PolymorphicPartitionPolicy<
 
 template <typename Char, typename PolymorphicPolicy>
 PolymorphicPolicy init_partition_policy(SamplerArgs const& sampler,
-                                        SplitterSorter splitter_sorter) {
+                                        SplitterSorter splitter_sorter,
+                                        bool keep_ties = false) {
     auto disptach_policy = [&]<typename PartitionPolicy>() {
-        return PolymorphicPolicy{PartitionPolicy{sampler.sampling_factor}};
+        return PolymorphicPolicy{PartitionPolicy{sampler.get_config(), keep_ties}};
     };
 
+    if (sampler.exact_splitting) {
+        using namespace dss_mehnert::partition;
+        if (sampler.sample_chars) {
+            return PolymorphicPolicy{ExactPartitionPolicy<true>{}};
+        } else {
+            return PolymorphicPolicy{ExactPartitionPolicy<false>{}};
+        }
+    }
+
     auto dispatch_sorter = [&]<typename SamplePolicy>() {
         using namespace dss_mehnert::partition;
 
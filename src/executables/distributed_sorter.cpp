@@ -24,10 +24,13 @@
 #include "executables/common_cli.hpp"
 #include "mpi/communicator.hpp"
 #include "mpi/is_sorted.hpp"
+#include "mpi/progress.hpp"
 #include "options.hpp"
+#include "sorter/distributed/incremental.hpp"
 #include "sorter/distributed/merge_sort.hpp"
 #include "sorter/distributed/permutation.hpp"
 #include "sorter/distributed/prefix_doubling.hpp"
+#include "sorter/distributed/rebalance.hpp"
 #include "strings/stringset.hpp"
 #include "util/measuringTool.hpp"
 #include "util/string_generator.hpp"
@@ -43,9 +46,12 @@ enum class StringGenerator {
 
 enum class Permutation { simple = 0, multi_level, sentinel };
 
+enum class Rebalance { none = 0, strings, chars, sentinel };
+
 struct SorterArgs : public CommonArgs {
     size_t string_generator = static_cast<size_t>(StringGenerator::dn_ratio);
     size_t permutation = static_cast<size_t>(Permutation::simple);
+    size_t rebalance = static_cast<size_t>(Rebalance::none);
     size_t num_strings = 100000;
     size_t len_strings = 100;
     size_t len_strings_min = len_strings;
@@ -54,6 +60,12 @@ struct SorterArgs : public CommonArgs {
     double dn_ratio = 0.5;
     size_t iteration = 0;
     bool strong_scaling = false;
+    bool compute_names = false;
+    bool compact_prefixes = false;
+    bool overlap_splitters = false;
+    bool deliver_strings = false;
+    size_t insert_batches = 0;
+    size_t merge_sequences = 0;
     std::vector<size_t> levels;
 
     std::string get_prefix(dss_mehnert::Communicator const& comm) const {
@@ -62,6 +74,13 @@ struct SorterArgs : public CommonArgs {
                + " num_strings="    + std::to_string(num_strings)
                + " len_strings="    + std::to_string(len_strings)
                + " num_levels="     + std::to_string(levels.size())
+               + " rebalance="      + std::string(get_name(get_rebalance_kind()))
+               + " names="          + std::to_string(compute_names)
+               + " compact_prefixes=" + std::to_string(compact_prefixes)
+               + " overlap_splitters=" + std::to_string(overlap_splitters)
+               + " deliver_strings="  + std::to_string(deliver_strings)
+               + " insert_batches="   + std::to_string(insert_batches)
+               + " merge_sequences="  + std::to_string(merge_sequences)
                + " iteration="      + std::to_string(iteration)
                + " strong_scaling=" + std::to_string(strong_scaling)
                + " dn_ratio="       + std::to_string(dn_ratio);
@@ -71,6 +90,39 @@ struct SorterArgs : public CommonArgs {
     size_t scaled_strings(dss_mehnert::Communicator const& comm) const {
         return (strong_scaling ? 1 : comm.size()) * num_strings;
     }
+
+    dss_mehnert::sorter::RebalanceKind get_rebalance_kind() const {
+        using dss_mehnert::sorter::RebalanceKind;
+
+        switch (clamp_enum_value<Rebalance>(rebalance)) {
+            case Rebalance::none:
+                return RebalanceKind::none;
+            case Rebalance::strings:
+                return RebalanceKind::strings;
+            case Rebalance::chars:
+                return RebalanceKind::chars;
+            case Rebalance::sentinel:
+                break;
+        }
+        tlx_die("unknown rebalancing kind");
+    }
+
+    void validate() const {
+        tlx_die_verbose_if(insert_batches > 0 && prefix_doubling,
+                           "inserting batches is only supported by merge sort");
+        tlx_die_verbose_if(insert_batches > 0 && compute_names,
+                           "inserting batches does not support computing names");
+        tlx_die_verbose_if(merge_sequences > 0 && prefix_doubling,
+                           "merging sequences is only supported by merge sort");
+        tlx_die_verbose_if(merge_sequences > 0 && (compute_names || insert_batches > 0),
+                           "merging sequences does not support names or inserting batches");
+        tlx_die_verbose_if(compute_names && deliver_strings,
+                           "delivering strings does not support computing names");
+        tlx_die_verbose_if(overlap_splitters && sampler.sample_indexed,
+                           "overlapping splitters does not support indexed sampling");
+        tlx_die_verbose_if(overlap_splitters && sampler.exact_splitting,
+                           "overlapping splitters does not support exact splitting");
+    }
 };
 
 template <typename StringSet>
@@ -125,6 +177,28 @@ auto generate_strings(SorterArgs const& args, dss_mehnert::Communicator const& c
     return input_container;
 }
 
+// Split the input into `num_parts` consecutive parts of roughly equal size.
+template <typename StringSet>
+auto split_input(dss_mehnert::StringLcpContainer<StringSet>&& container, size_t const num_parts) {
+    using Container = dss_mehnert::StringLcpContainer<StringSet>;
+
+    container.make_contiguous();
+    auto const& raw_strings = container.raw_strings();
+    auto const& strings = container.get_strings();
+    auto const char_offset = [&](size_t const i) -> size_t {
+        return i < strings.size() ? strings[i].string - raw_strings.data() : raw_strings.size();
+    };
+
+    std::vector<Container> parts;
+    for (size_t i = 0; i != num_parts; ++i) {
+        auto const begin = char_offset(i * strings.size() / num_parts);
+        auto const end = char_offset((i + 1) * strings.size() / num_parts);
+        parts.emplace_back(std::vector(raw_strings.begin() + begin, raw_strings.begin() + end));
+    }
+    container.delete_all();
+    return parts;
+}
+
 template <typename CharType, typename AlltoallConfig, typename BloomFilterPolicy>
 void run_merge_sort(SorterArgs const& args,
                     std::string prefix,
@@ -150,6 +224,14 @@ void run_merge_sort(SorterArgs const& args,
         if (args.check_sorted || args.check_complete) {
             checker.store_container(input_container);
         }
+
+        // the input is sorted in parts, all but the first are inserted incrementally
+        std::vector<dss_mehnert::StringLcpContainer<StringSet>> batches;
+        if (args.insert_batches > 0) {
+            batches = split_input(std::move(input_container), args.insert_batches + 1);
+            input_container = std::move(batches.front());
+            batches.erase(batches.begin());
+        }
         measuring_tool.enableCommVolume();
 
         comm.barrier();
@@ -157,14 +239,47 @@ void run_merge_sort(SorterArgs const& args,
         measuring_tool.start("none", "create_communicators");
         auto const first_level = get_first_level(args.levels, comm);
         Subcommunicators comms{first_level, args.levels.end(), comm};
+        dss_mehnert::mpi::init_alltoallv_combined<alltoall_config.alltoall_kind>(comms);
         measuring_tool.stop("none", "create_communicators", comm);
 
-        measuring_tool.start("none", "sorting_overall");
         MergeSort merge_sort{dss_mehnert::init_partition_policy<CharType, PartitionPolicy>(
                                  args.sampler,
-                                 args.get_splitter_sorter()),
-                             std::move(redistribution)};
-        merge_sort.sort(input_container, comms);
+                                 args.get_splitter_sorter(),
+                                 args.compute_names),
+                             std::move(redistribution),
+                             args.get_local_sorter(),
+                             args.overlap_splitters};
+
+        // the sequences to be merged are sorted before the measurement starts
+        std::vector<dss_mehnert::StringLcpContainer<StringSet>> sequences;
+        if (args.merge_sequences > 0) {
+            measuring_tool.disable();
+            measuring_tool.disableCommVolume();
+            sequences = split_input(std::move(input_container), args.merge_sequences);
+            for (auto& sequence: sequences) {
+                merge_sort.sort(sequence, comms);
+            }
+            measuring_tool.enableCommVolume();
+            measuring_tool.enable();
+            comm.barrier();
+        }
+
+        measuring_tool.start("none", "sorting_overall");
+        if (!sequences.empty()) {
+            merge_sort.merge(input_container, std::move(sequences), comms);
+        } else if (args.compute_names) {
+            merge_sort.sort_named(input_container, comms);
+        } else {
+            merge_sort.sort(input_container, comms);
+        }
+        if (!batches.empty()) {
+            dss_mehnert::sorter::IncrementalMergeSort<alltoall_config> incremental_sort{
+                args.get_local_sorter()};
+            for (auto& batch: batches) {
+                incremental_sort.insert(input_container, std::move(batch), comm);
+            }
+        }
+        dss_mehnert::sorter::rebalance(input_container, args.get_rebalance_kind(), comm);
         measuring_tool.stop("none", "sorting_overall", comm);
 
         measuring_tool.disableCommVolume();
@@ -224,8 +339,13 @@ void run_prefix_doubling(SorterArgs const& args,
         auto input_container = generate_strings<StringSet>(args, comm);
 
         dss_mehnert::PrefixDoublingChecker<StringSet> checker;
+        dss_mehnert::MergeSortChecker<StringSet> output_checker;
         if (args.check_sorted || args.check_complete) {
-            checker.store_container(input_container);
+            if (args.deliver_strings) {
+                output_checker.store_container(input_container);
+            } else {
+                checker.store_container(input_container);
+            }
         }
         measuring_tool.enableCommVolume();
 
@@ -234,14 +354,57 @@ void run_prefix_doubling(SorterArgs const& args,
         measuring_tool.start("none", "create_communicators");
         auto const first_level = get_first_level(args.levels, comm);
         Subcommunicators comms{first_level, args.levels.end(), comm};
+        dss_mehnert::mpi::init_alltoallv_combined<alltoall_config.alltoall_kind>(comms);
         measuring_tool.stop("none", "create_communicators", comm);
 
         measuring_tool.start("none", "sorting_overall");
         MergeSort merge_sort{dss_mehnert::init_partition_policy<CharType, PartitionPolicy>(
                                  args.sampler,
-                                 args.get_splitter_sorter()),
-                             std::move(redistribution)};
-        auto permutation = merge_sort.sort(std::move(input_container), comms);
+                                 args.get_splitter_sorter(),
+                                 args.compute_names),
+                             std::move(redistribution),
+                             args.get_local_sorter(),
+                             args.bloomfilter_tail,
+                             args.compact_prefixes};
+
+        if (args.deliver_strings) {
+            if constexpr (std::is_same_v<Permutation, dss_mehnert::SimplePermutation>) {
+                auto output_container = merge_sort.sort_direct(std::move(input_container), comms);
+                measuring_tool.stop("none", "sorting_overall", comm);
+
+                measuring_tool.disableCommVolume();
+                measuring_tool.disable();
+
+                if (args.check_sorted) {
+                    auto const output_ss = output_container.make_string_set();
+                    auto const is_sorted = output_checker.is_sorted(output_ss, comm);
+                    die_verbose_unless(is_sorted, "output is not sorted");
+                    auto const is_complete = output_checker.is_complete(output_container, comm);
+                    die_verbose_unless(is_complete, "output is missing chars or strings");
+                }
+                if (args.check_complete) {
+                    auto const is_exact = output_checker.check_exhaustive(output_container, comm);
+                    die_verbose_unless(is_exact, "output is not a permutation of the input");
+                }
+
+                measuring_tool.write_on_root(std::cout, comm);
+                measuring_tool.reset();
+                return;
+            } else {
+                tlx_die("delivering strings requires the simple permutation");
+            }
+        }
+
+        auto permutation = [&] {
+            if constexpr (std::is_same_v<Permutation, dss_mehnert::SimplePermutation>) {
+                if (args.compute_names) {
+                    return merge_sort.sort_named(std::move(input_container), comms).permutation;
+                }
+            } else {
+                tlx_die_verbose_if(args.compute_names, "names require the simple permutation");
+            }
+            return merge_sort.sort(std::move(input_container), comms);
+        }();
         measuring_tool.stop("none", "sorting_overall", comm);
 
         measuring_tool.disableCommVolume();
@@ -329,6 +492,10 @@ int main(int argc, char* argv[]) {
                   args.permutation,
                   "type of permutation to use for PDMS "
                   "([0]=simple, 1=multi-level)");
+    cp.add_size_t("rebalance",
+                  args.rebalance,
+                  "balance the output of merge sort afterwards "
+                  "([0]=none, 1=strings, 2=chars)");
     cp.add_string('y', "path", args.path, "path to input file");
     cp.add_double('r', "DN-ratio", args.dn_ratio, "D/N ratio of generated strings");
     cp.add_size_t('n', "num-strings", args.num_strings, "number of strings to be generated");
@@ -342,6 +509,24 @@ int main(int argc, char* argv[]) {
                   args.len_strings_max,
                   "maximum length of generated strings");
     cp.add_flag('x', "strong-scaling", args.strong_scaling, "perform a strong scaling experiment");
+    cp.add_flag("names",
+                args.compute_names,
+                "compute the dense rank of each string after sorting");
+    cp.add_flag("compact-prefixes",
+                args.compact_prefixes,
+                "reduce the input to distinguishing prefixes before the exchange (PDMS only)");
+    cp.add_flag("deliver-strings",
+                args.deliver_strings,
+                "send the full strings directly to their final PE after sorting (PDMS only)");
+    cp.add_flag("overlap-splitters",
+                args.overlap_splitters,
+                "choose splitters from the unsorted input while sorting locally (MS only)");
+    cp.add_size_t("insert-batches",
+                  args.insert_batches,
+                  "sort part of the input, then insert the rest in this many batches (MS only)");
+    cp.add_size_t("merge-sequences",
+                  args.merge_sequences,
+                  "sort the input as this many sequences, then measure merging them (MS only)");
 
     std::vector<std::string> levels_param;
     cp.add_opt_param_stringlist("group-size",
@@ -353,8 +538,12 @@ int main(int argc, char* argv[]) {
     }
 
     parse_level_arg(levels_param, args.levels);
+    args.validate();
 
-    kamping::Environment env{argc, argv};
+    // MPI is finalized by `mpi_init` if it was initialized there
+    dss_mehnert::mpi::ThreadMultipleInit mpi_init{args.progress_thread, argc, argv};
+    kamping::Environment<kamping::InitMPIMode::InitFinalizeIfNecessary> env{argc, argv};
+    dss_mehnert::mpi::ProgressThread progress_thread{args.progress_thread};
 
     if constexpr (CliOptions::use_shared_memory_sort) {
         using CharType = unsigned char;
@@ -25,6 +25,7 @@
 #include "executables/common_cli.hpp"
 #include "mpi/communicator.hpp"
 #include "mpi/is_sorted.hpp"
+#include "mpi/progress.hpp"
 #include "sorter/distributed/space_efficient.hpp"
 #include "strings/stringset.hpp"
 #include "util/measuringTool.hpp"
@@ -53,7 +54,10 @@ struct SorterArgs : public CommonArgs {
     bool shuffle = false;
     std::string path;
     size_t permutation = static_cast<size_t>(Permutation::multi_level);
+    bool inverse_permutation = false;
     size_t quantile_size = 100 * 1024 * 1024;
+    size_t permutation_batch_memory = 0;
+    bool permutation_compression = false;
     size_t iteration = 0;
     std::vector<size_t> levels;
 
@@ -74,6 +78,9 @@ struct SorterArgs : public CommonArgs {
                + " difference_cover=" + std::to_string(difference_cover)
                + " num_levels="       + std::to_string(levels.size())
                + " quantile_size="    + std::to_string(quantile_size)
+               + " inverse_perm="     + std::to_string(inverse_permutation)
+               + " perm_batch_memory=" + std::to_string(permutation_batch_memory)
+               + " perm_compression=" + std::to_string(permutation_compression)
                + " iteration="        + std::to_string(iteration);
         // clang-format on
     }
@@ -267,19 +274,49 @@ void run_space_efficient_sort(SorterArgs const& args,
         measuring_tool.start("none", "create_communicators");
         auto const first_level = get_first_level(args.levels, comm);
         Subcommunicators comms{first_level, args.levels.end(), comm};
+        dss_mehnert::mpi::init_alltoallv_combined<config.alltoall_kind>(comms);
         measuring_tool.stop("none", "create_communicators", comm);
 
         measuring_tool.start("none", "sorting_overall");
         Sorter merge_sort{std::move(bloom_filter),
                           dss_mehnert::init_partition_policy<CharType, PartitionPolicy>(
                               args.quantile_sampler,
-                              args.get_splitter_sorter()),
-                          args.quantile_size};
-        auto global_ranks = merge_sort.sort(std::move(input_container), comms);
-        measuring_tool.stop("none", "sorting_overall", comm);
+                              args.get_splitter_sorter(),
+                              !is_unique),
+                          args.quantile_size,
+                          args.permutation_batch_memory,
+                          args.permutation_compression};
+        auto global_ranks = [&] {
+            if constexpr (std::is_same_v<Permutation, dss_mehnert::SimplePermutation>) {
+                if (args.inverse_permutation) {
+                    size_t const num_strings = input_container.size();
+                    auto const quantiles =
+                        merge_sort.sort_inverse(std::move(input_container), comms);
+                    measuring_tool.stop("none", "sorting_overall", comm);
+
+                    // ranks at the origin PEs are only computed for validation
+                    measuring_tool.disable();
+                    std::vector<size_t> global_ranks(num_strings);
+                    for (auto const& [permutation, global_offset]: quantiles) {
+                        permutation.apply(global_ranks, global_offset, comms);
+                    }
+                    measuring_tool.enable();
+                    return global_ranks;
+                }
+            } else {
+                tlx_die_verbose_if(args.inverse_permutation,
+                                   "inverse permutation requires the simple permutation");
+            }
+            auto global_ranks = merge_sort.sort(std::move(input_container), comms);
+            measuring_tool.stop("none", "sorting_overall", comm);
+            return global_ranks;
+        }();
 
         measuring_tool.disableCommVolume();
         count_duplicate_ranks(global_ranks, comm);
+        if constexpr (!is_unique) {
+            measuring_tool.add(merge_sort.num_distinct(), "num_distinct");
+        }
 
         measuring_tool.disable();
 
@@ -303,8 +340,11 @@ void run_space_efficient_sort(SorterArgs const& args,
             run_sorter(
                 BloomFilterPolicy{dss_mehnert::init_partition_policy<CharType, PartitionPolicy>(
                                       args.sampler,
-                                      args.get_splitter_sorter()),
-                                  std::move(redistribution)});
+                                      args.get_splitter_sorter(),
+                                      !is_unique),
+                                  std::move(redistribution),
+                                  args.get_local_sorter(),
+                                  args.bloomfilter_tail});
         } else {
             // todo maybe add cmake flag for this
             using BloomFilterPolicy =
@@ -312,8 +352,10 @@ void run_space_efficient_sort(SorterArgs const& args,
             run_sorter(
                 BloomFilterPolicy{dss_mehnert::init_partition_policy<CharType, PartitionPolicy>(
                                       args.sampler,
-                                      args.get_splitter_sorter()),
-                                  std::move(redistribution)});
+                                      args.get_splitter_sorter(),
+                                      !is_unique),
+                                  std::move(redistribution),
+                                  args.get_local_sorter()});
         }
     };
 
@@ -355,6 +397,8 @@ void dispatch_permutation(SorterArgs const& args) {
 
 int main(int argc, char* argv[]) {
     SorterArgs args;
+    // limit the memory used by local sorting by default
+    args.local_sort_memory = 500 * 1024 * 1024;
 
     tlx::CmdlineParser cp;
     cp.set_description("a space efficient distributed string sorter");
@@ -408,10 +452,20 @@ int main(int argc, char* argv[]) {
                   args.permutation,
                   "type of permutation to use for SEMS"
                   "(0=simple, [1]=multi-level, 2=non-unique)");
+    cp.add_flag("inverse-permutation",
+                args.inverse_permutation,
+                "leave the (simple) permutation in sorted order at the destination PEs");
     cp.add_bytes('q',
                  "quantile-size",
                  args.quantile_size,
                  "work on quantiles of the given size [default: 100MiB]");
+    cp.add_bytes("permutation-batch-memory",
+                 args.permutation_batch_memory,
+                 "memory used to buffer permutations of multiple quantiles "
+                 "before writing them back (0=write back each quantile)");
+    cp.add_flag("permutation-compression",
+                args.permutation_compression,
+                "send global indices of the multi-level permutation as varint deltas");
 
     std::vector<std::string> levels_param;
     cp.add_opt_param_stringlist("group-size",
@@ -427,7 +481,10 @@ int main(int argc, char* argv[]) {
     }
     parse_level_arg(levels_param, args.levels);
 
-    kamping::Environment env{argc, argv};
+    // MPI is finalized by `mpi_init` if it was initialized there
+    dss_mehnert::mpi::ThreadMultipleInit mpi_init{args.progress_thread, argc, argv};
+    kamping::Environment<kamping::InitMPIMode::InitFinalizeIfNecessary> env{argc, argv};
+    dss_mehnert::mpi::ProgressThread progress_thread{args.progress_thread};
 
     if constexpr (CliOptions::use_shared_memory_sort) {
         using CharType = unsigned char;
@@ -5,7 +5,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <limits>
+#include <memory>
 #include <numeric>
 #include <type_traits>
 #include <utility>
@@ -13,10 +16,12 @@
 #include <span>
 
 #include <kamping/collectives/alltoall.hpp>
+#include <kamping/mpi_datatype.hpp>
 #include <kamping/named_parameter_check.hpp>
 #include <kamping/named_parameter_selection.hpp>
 #include <kamping/named_parameter_types.hpp>
 #include <kamping/named_parameters.hpp>
+#include <mpi.h>
 #include <tlx/die/core.hpp>
 
 #include "mpi/big_type.hpp"
@@ -26,7 +31,184 @@
 namespace dss_mehnert {
 namespace mpi {
 
-enum class AlltoallvCombinedKind { combined, native, direct };
+enum class AlltoallvCombinedKind { combined, native, direct, node_aggregated, rma, neighbor };
+
+namespace _internal {
+
+// Personalized exchange using one non-blocking message per non-empty count. Counts may exceed
+// the range of int, using the large-count functions of MPI-4 or derived datatypes otherwise.
+template <typename DataType>
+std::vector<DataType> alltoallv_p2p(
+    DataType const* send_data,
+    std::span<size_t const> send_counts,
+    std::span<size_t const> recv_counts,
+    MPI_Comm const comm
+) {
+    int rank = 0, size = 0;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    std::vector<size_t> send_displs(size), recv_displs(size);
+    std::exclusive_scan(send_counts.begin(), send_counts.end(), send_displs.begin(), size_t{0});
+    std::exclusive_scan(recv_counts.begin(), recv_counts.end(), recv_displs.begin(), size_t{0});
+
+    auto const recv_total = recv_displs.back() + recv_counts.back();
+    std::vector<DataType> receive_data(recv_total);
+    std::vector<MPI_Request> requests;
+    requests.reserve(2 * size);
+
+    [[maybe_unused]] auto const type = kamping::mpi_datatype<DataType>();
+
+    for (int i = 0; i < size; ++i) {
+        int source = (rank + (size - i)) % size;
+        if (recv_counts[source] > 0) {
+            auto const recv_ptr = receive_data.data() + recv_displs[source];
+            auto& request = requests.emplace_back(MPI_REQUEST_NULL);
+#if MPI_VERSION >= 4
+            MPI_Irecv_c(recv_ptr, recv_counts[source], type, source, 44227, comm, &request);
+#else
+            auto recv_type = dss_schimek::mpi::get_big_type<DataType>(recv_counts[source]);
+            MPI_Irecv(recv_ptr, 1, recv_type, source, 44227, comm, &request);
+#endif
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        int target = (rank + i) % size;
+        if (send_counts[target] > 0) {
+            auto const send_ptr = send_data + send_displs[target];
+            auto& request = requests.emplace_back(MPI_REQUEST_NULL);
+#if MPI_VERSION >= 4
+            MPI_Issend_c(send_ptr, send_counts[target], type, target, 44227, comm, &request);
+#else
+            auto send_type = dss_schimek::mpi::get_big_type<DataType>(send_counts[target]);
+            MPI_Issend(send_ptr, 1, send_type, target, 44227, comm, &request);
+#endif
+        }
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    return receive_data;
+}
+
+// Assignment of the PEs of a communicator to shared memory nodes. Nodes are numbered by the
+// rank of their leader (the PE with local rank zero) in the leader communicator.
+struct NodeTopology {
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    MPI_Comm leader_comm = MPI_COMM_NULL;
+    size_t node = 0;
+    std::vector<int> node_of, local_rank_of;
+    std::vector<std::vector<int>> members;
+
+    explicit NodeTopology(MPI_Comm const comm) {
+        int rank = 0, size = 0, local_rank = 0;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &local_rank);
+        MPI_Comm_split(comm, local_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+
+        int node_idx = 0;
+        if (leader_comm != MPI_COMM_NULL) {
+            MPI_Comm_rank(leader_comm, &node_idx);
+        }
+        MPI_Bcast(&node_idx, 1, MPI_INT, 0, node_comm);
+        node = node_idx;
+
+        std::array<int, 2> const local{node_idx, local_rank};
+        std::vector<std::array<int, 2>> global(size);
+        MPI_Allgather(local.data(), 2, MPI_INT, global.data(), 2, MPI_INT, comm);
+
+        // local ranks are ordered by global rank, hence the position within a node is the rank
+        for (int i = 0; i != size; ++i) {
+            auto const [node_i, local_rank_i] = global[i];
+            node_of.push_back(node_i);
+            local_rank_of.push_back(local_rank_i);
+            members.resize(std::max<size_t>(members.size(), node_i + 1));
+            members[node_i].push_back(i);
+        }
+    }
+
+    NodeTopology(NodeTopology const&) = delete;
+    NodeTopology& operator=(NodeTopology const&) = delete;
+
+    ~NodeTopology() {
+        int is_finalized = 0;
+        MPI_Finalized(&is_finalized);
+        if (!is_finalized) {
+            if (leader_comm != MPI_COMM_NULL) {
+                MPI_Comm_free(&leader_comm);
+            }
+            MPI_Comm_free(&node_comm);
+        }
+    }
+
+    bool is_leader() const { return leader_comm != MPI_COMM_NULL; }
+};
+
+// Distributed graph communicator over the PEs of an exchange communicator. The exchange
+// communicator of a grid level only contains the fixed partners of a PE (one PE per group),
+// which are all neighbors, because each of them receives one interval.
+struct NeighborTopology {
+    MPI_Comm graph_comm = MPI_COMM_NULL;
+
+    explicit NeighborTopology(MPI_Comm const comm) {
+        int size = 0;
+        MPI_Comm_size(comm, &size);
+
+        std::vector<int> neighbors(size);
+        std::iota(neighbors.begin(), neighbors.end(), 0);
+        MPI_Dist_graph_create_adjacent(
+            comm,
+            size,
+            neighbors.data(),
+            MPI_UNWEIGHTED,
+            size,
+            neighbors.data(),
+            MPI_UNWEIGHTED,
+            MPI_INFO_NULL,
+            false,
+            &graph_comm
+        );
+    }
+
+    NeighborTopology(NeighborTopology const&) = delete;
+    NeighborTopology& operator=(NeighborTopology const&) = delete;
+
+    ~NeighborTopology() {
+        int is_finalized = 0;
+        MPI_Finalized(&is_finalized);
+        if (!is_finalized) {
+            MPI_Comm_free(&graph_comm);
+        }
+    }
+};
+
+// Returns the topology of the given communicator, which is created collectively on first use.
+// Topologies are cached by process group, hence congruent communicators (e.g. those created in
+// later iterations) reuse the same topology. The cache is consistent across the PEs of each
+// group, since all of them take part in creating a topology.
+template <typename Topology>
+std::shared_ptr<Topology const> get_cached_topology(MPI_Comm const comm) {
+    struct Entry {
+        MPI_Group group;
+        std::shared_ptr<Topology const> topology;
+    };
+    static std::vector<Entry> cache;
+
+    MPI_Group group;
+    MPI_Comm_group(comm, &group);
+    for (auto const& entry: cache) {
+        int result = MPI_UNEQUAL;
+        MPI_Group_compare(entry.group, group, &result);
+        if (result == MPI_IDENT) {
+            MPI_Group_free(&group);
+            return entry.topology;
+        }
+    }
+    cache.push_back({group, std::make_shared<Topology const>(comm)});
+    return cache.back().topology;
+}
+
+} // namespace _internal
 
 template <typename Comm>
 class AlltoallvCombinedPlugin : public kamping::plugins::PluginBase<Comm, AlltoallvCombinedPlugin> {
@@ -47,6 +229,10 @@ public:
         SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
     ) const {
         if constexpr (kind == AlltoallvCombinedKind::combined) {
+#if MPI_VERSION >= 4
+            // large counts are supported natively, no global decision is required
+            return alltoallv_large_count(send_buf, send_counts, recv_counts);
+#else
             auto const send_total =
                 std::accumulate(send_counts.begin(), send_counts.end(), size_t{0});
             auto const recv_total =
@@ -62,10 +248,17 @@ public:
             } else {
                 return alltoallv_direct(send_buf, send_counts, recv_counts);
             }
+#endif
         } else if constexpr (kind == AlltoallvCombinedKind::native) {
             return alltoallv_native(send_buf, send_counts, recv_counts);
         } else if constexpr (kind == AlltoallvCombinedKind::direct) {
             return alltoallv_direct(send_buf, send_counts, recv_counts);
+        } else if constexpr (kind == AlltoallvCombinedKind::node_aggregated) {
+            return alltoallv_node_aggregated(send_buf, send_counts, recv_counts);
+        } else if constexpr (kind == AlltoallvCombinedKind::rma) {
+            return alltoallv_rma(send_buf, send_counts, recv_counts);
+        } else if constexpr (kind == AlltoallvCombinedKind::neighbor) {
+            return alltoallv_neighbor(send_buf, send_counts, recv_counts);
         } else {
             []<AlltoallvCombinedKind type_ = kind> (){
                 static_assert(type_ != type_, "invalid alltoallv combined kind used");
@@ -74,20 +267,31 @@ public:
         }
     }
 
+    // Create the topology used by the given kind of exchange up front, such that it is not
+    // created during the first (timed) exchange.
+    template <AlltoallvCombinedKind kind>
+    void init_alltoallv_combined() const {
+        if constexpr (kind == AlltoallvCombinedKind::node_aggregated) {
+            get_node_topology();
+        } else if constexpr (kind == AlltoallvCombinedKind::neighbor) {
+            get_neighbor_topology();
+        }
+    }
+
 private:
     template <typename SendBuf>
     auto alltoallv_native(
         SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
     ) const {
-        KASSERT(
-            std::all_of(send_counts.begin(), send_counts.end(), std::in_range<int, size_t>),
-            "all send counts need to fit into an int",
-            kamping::assert::normal
-        );
-        KASSERT(
-            std::all_of(recv_counts.begin(), recv_counts.end(), std::in_range<int, size_t>),
-            "all recv counts need to fit into an int",
-            kamping::assert::normal
+#if MPI_VERSION >= 4
+        return alltoallv_large_count(send_buf, send_counts, recv_counts);
+#else
+        // displacements are ints as well, hence the total counts need to fit into an int
+        auto const send_total = std::accumulate(send_counts.begin(), send_counts.end(), size_t{0});
+        auto const recv_total = std::accumulate(recv_counts.begin(), recv_counts.end(), size_t{0});
+        tlx_die_verbose_unless(
+            std::in_range<int>(send_total) && std::in_range<int>(recv_total),
+            "native alltoallv requires counts that fit into an int, use MPI 4 instead"
         );
 
         std::vector<int> send_counts_int{send_counts.begin(), send_counts.end()};
@@ -99,8 +303,56 @@ private:
                 kamping::recv_counts(recv_counts_int)
             )
             .extract_recv_buffer();
+#endif
     }
 
+#if MPI_VERSION >= 4
+    template <typename SendBuf>
+    auto alltoallv_large_count(
+        SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
+    ) const {
+        using DataType = std::remove_reference_t<SendBuf>::value_type;
+
+        auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+
+        auto const& comm = this->to_communicator();
+        std::vector<MPI_Count> send_counts_c{send_counts.begin(), send_counts.end()};
+        std::vector<MPI_Count> recv_counts_c{recv_counts.begin(), recv_counts.end()};
+        std::vector<MPI_Aint> send_displs(comm.size()), recv_displs(comm.size());
+        std::exclusive_scan(
+            send_counts.begin(),
+            send_counts.end(),
+            send_displs.begin(),
+            MPI_Aint{0}
+        );
+        std::exclusive_scan(
+            recv_counts.begin(),
+            recv_counts.end(),
+            recv_displs.begin(),
+            MPI_Aint{0}
+        );
+
+        auto const send_total = send_displs.back() + send_counts.back();
+        auto const recv_total = recv_displs.back() + recv_counts.back();
+        measuring_tool.addRawCommunication(send_total * sizeof(DataType), "alltoallv_large_count");
+
+        std::vector<DataType> receive_data(recv_total);
+        auto const type = kamping::mpi_datatype<DataType>();
+        MPI_Alltoallv_c(
+            send_buf.data(),
+            send_counts_c.data(),
+            send_displs.data(),
+            type,
+            receive_data.data(),
+            recv_counts_c.data(),
+            recv_displs.data(),
+            type,
+            comm.mpi_communicator()
+        );
+        return receive_data;
+    }
+#endif
+
     template <typename SendBuf>
     auto alltoallv_direct(
         SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
@@ -111,52 +363,342 @@ private:
         auto& measuring_tool = measurement::MeasuringTool::measuringTool();
 
         auto const& comm = this->to_communicator();
-        std::vector<size_t> send_displs(comm.size()), recv_displs(comm.size());
+        auto const send_total = std::accumulate(send_counts.begin(), send_counts.end(), size_t{0});
+        measuring_tool.addRawCommunication(send_total * sizeof(DataType), "alltoallv_direct");
+
+        return _internal::alltoallv_p2p<DataType>(
+            send_buf.data(),
+            send_counts,
+            recv_counts,
+            comm.mpi_communicator()
+        );
+    }
+
+    template <typename SendBuf>
+    auto alltoallv_neighbor(
+        SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
+    ) const {
+        using DataType = std::remove_reference_t<SendBuf>::value_type;
+
+        auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+
+        auto const& topology = get_neighbor_topology();
+        size_t const num_pes = send_counts.size();
+
+        std::vector<size_t> send_displs(num_pes), recv_displs(num_pes);
         std::exclusive_scan(send_counts.begin(), send_counts.end(), send_displs.begin(), size_t{0});
         std::exclusive_scan(recv_counts.begin(), recv_counts.end(), recv_displs.begin(), size_t{0});
 
         auto const send_total = send_displs.back() + send_counts.back();
-        measuring_tool.addRawCommunication(send_total * sizeof(DataType), "alltoallv_direct");
+        auto const recv_total = recv_displs.back() + recv_counts.back();
+        measuring_tool.addRawCommunication(send_total * sizeof(DataType), "alltoallv_neighbor");
 
+        std::vector<DataType> receive_data(recv_total);
+        auto const type = kamping::mpi_datatype<DataType>();
+#if MPI_VERSION >= 4
+        std::vector<MPI_Count> send_counts_c{send_counts.begin(), send_counts.end()};
+        std::vector<MPI_Count> recv_counts_c{recv_counts.begin(), recv_counts.end()};
+        std::vector<MPI_Aint> send_displs_c{send_displs.begin(), send_displs.end()};
+        std::vector<MPI_Aint> recv_displs_c{recv_displs.begin(), recv_displs.end()};
+        MPI_Neighbor_alltoallv_c(
+            send_buf.data(),
+            send_counts_c.data(),
+            send_displs_c.data(),
+            type,
+            receive_data.data(),
+            recv_counts_c.data(),
+            recv_displs_c.data(),
+            type,
+            topology.graph_comm
+        );
+#else
+        tlx_die_verbose_unless(
+            std::in_range<int>(send_total) && std::in_range<int>(recv_total),
+            "neighbor alltoallv requires counts that fit into an int, use MPI 4 instead"
+        );
+
+        std::vector<int> send_counts_int{send_counts.begin(), send_counts.end()};
+        std::vector<int> recv_counts_int{recv_counts.begin(), recv_counts.end()};
+        std::vector<int> send_displs_int{send_displs.begin(), send_displs.end()};
+        std::vector<int> recv_displs_int{recv_displs.begin(), recv_displs.end()};
+        MPI_Neighbor_alltoallv(
+            send_buf.data(),
+            send_counts_int.data(),
+            send_displs_int.data(),
+            type,
+            receive_data.data(),
+            recv_counts_int.data(),
+            recv_displs_int.data(),
+            type,
+            topology.graph_comm
+        );
+#endif
+        return receive_data;
+    }
+
+    // One-sided exchange that puts the data directly into a window around the preallocated
+    // receive buffer. Synchronization uses post-start-complete-wait, restricted to the PEs that
+    // actually exchange data. The receive offsets are exchanged up front using an alltoall.
+    template <typename SendBuf>
+    auto alltoallv_rma(
+        SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
+    ) const {
+        using DataType = std::remove_reference_t<SendBuf>::value_type;
+
+        auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+
+        auto const& comm = this->to_communicator();
+        auto const comm_mpi = comm.mpi_communicator();
+        size_t const num_pes = comm.size();
+
+        std::vector<size_t> send_displs(num_pes), recv_displs(num_pes), target_displs(num_pes);
+        std::exclusive_scan(send_counts.begin(), send_counts.end(), send_displs.begin(), size_t{0});
+        std::exclusive_scan(recv_counts.begin(), recv_counts.end(), recv_displs.begin(), size_t{0});
+        auto const count_type = kamping::mpi_datatype<size_t>();
+        MPI_Alltoall(
+            recv_displs.data(),
+            1,
+            count_type,
+            target_displs.data(),
+            1,
+            count_type,
+            comm_mpi
+        );
+
+        auto const send_total = send_displs.back() + send_counts.back();
         auto const recv_total = recv_displs.back() + recv_counts.back();
+        measuring_tool.addRawCommunication(send_total * sizeof(DataType), "alltoallv_rma");
+
         std::vector<DataType> receive_data(recv_total);
-        std::vector<MPI_Request> requests;
-        requests.reserve(2 * comm.size());
-
-        for (int i = 0; i < comm.size_signed(); ++i) {
-            int source = (comm.rank_signed() + (comm.size_signed() - i)) % comm.size_signed();
-            if (recv_counts[source] > 0) {
-                auto receive_type = dss_schimek::mpi::get_big_type<DataType>(recv_counts[source]);
-                MPI_Irecv(
-                    receive_data.data() + recv_displs[source],
-                    1,
-                    receive_type,
-                    source,
-                    44227,
-                    comm.mpi_communicator(),
-                    &requests.emplace_back(MPI_REQUEST_NULL)
-                );
+        MPI_Win window;
+        MPI_Win_create(
+            receive_data.data(),
+            static_cast<MPI_Aint>(recv_total * sizeof(DataType)),
+            sizeof(DataType),
+            MPI_INFO_NULL,
+            comm_mpi,
+            &window
+        );
+
+        std::vector<int> sources, targets;
+        for (int rank = 0; rank != comm.size_signed(); ++rank) {
+            if (recv_counts[rank] > 0) {
+                sources.push_back(rank);
             }
-        }
-        for (int i = 0; i < comm.size_signed(); ++i) {
-            int target = (comm.rank_signed() + i) % comm.size_signed();
-            if (send_counts[target] > 0) {
-                auto send_type = dss_schimek::mpi::get_big_type<DataType>(send_counts[target]);
-                MPI_Issend(
-                    send_buf.data() + send_displs[target],
-                    1,
-                    send_type,
-                    target,
-                    44227,
-                    comm.mpi_communicator(),
-                    &requests.emplace_back(MPI_REQUEST_NULL)
-                );
+            if (send_counts[rank] > 0) {
+                targets.push_back(rank);
             }
         }
-        MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+        MPI_Group comm_group, source_group, target_group;
+        MPI_Comm_group(comm_mpi, &comm_group);
+        MPI_Group_incl(comm_group, sources.size(), sources.data(), &source_group);
+        MPI_Group_incl(comm_group, targets.size(), targets.data(), &target_group);
+
+        MPI_Win_post(source_group, 0, window);
+        MPI_Win_start(target_group, 0, window);
+
+        std::vector<MPI_Datatype> types;
+        types.reserve(targets.size());
+        for (size_t i = 0; i != targets.size(); ++i) {
+            int const target = targets[(comm.rank() + i) % targets.size()];
+            auto const send_ptr = send_buf.data() + send_displs[target];
+            auto const target_displ = static_cast<MPI_Aint>(target_displs[target]);
+#if MPI_VERSION >= 4
+            auto const count = static_cast<MPI_Count>(send_counts[target]);
+            auto const type = kamping::mpi_datatype<DataType>();
+            MPI_Put_c(send_ptr, count, type, target, target_displ, count, type, window);
+#else
+            auto& type = types.emplace_back(
+                dss_schimek::mpi::get_big_type<DataType>(send_counts[target])
+            );
+            MPI_Put(send_ptr, 1, type, target, target_displ, 1, type, window);
+#endif
+        }
+
+        MPI_Win_complete(window);
+        MPI_Win_wait(window);
+        MPI_Win_free(&window);
+
+        std::for_each(types.begin(), types.end(), [](auto& type) { MPI_Type_free(&type); });
+        MPI_Group_free(&target_group);
+        MPI_Group_free(&source_group);
+        MPI_Group_free(&comm_group);
         return receive_data;
     }
+
+    // Two-level exchange via one leader per shared memory node. PEs send all data to their
+    // leader, leaders exchange one message per pair of nodes and scatter the received data to
+    // the PEs of their node. This uses O(nodes^2) instead of O(p^2) messages across nodes.
+    template <typename SendBuf>
+    auto alltoallv_node_aggregated(
+        SendBuf&& send_buf, std::span<size_t const> send_counts, std::span<size_t const> recv_counts
+    ) const {
+        using DataType = std::remove_reference_t<SendBuf>::value_type;
+
+        auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+
+        auto const& comm = this->to_communicator();
+        auto const& topology = get_node_topology();
+        auto const& local_members = topology.members[topology.node];
+        size_t const num_pes = comm.size(), local_size = local_members.size();
+
+        // gather the send counts and data of all PEs of the node at the leader
+        auto const count_type = kamping::mpi_datatype<size_t>();
+        std::vector<size_t> local_counts(topology.is_leader() ? local_size * num_pes : 0);
+        MPI_Gather(
+            send_counts.data(),
+            num_pes,
+            count_type,
+            local_counts.data(),
+            num_pes,
+            count_type,
+            0,
+            topology.node_comm
+        );
+
+        std::vector<size_t> gather_send_counts(local_size), gather_recv_counts(local_size);
+        auto const send_total = std::accumulate(send_counts.begin(), send_counts.end(), size_t{0});
+        gather_send_counts.front() = send_total;
+        if (topology.is_leader()) {
+            for (size_t i = 0; i != local_size; ++i) {
+                auto const begin = local_counts.begin() + i * num_pes;
+                gather_recv_counts[i] = std::accumulate(begin, begin + num_pes, size_t{0});
+            }
+        }
+        auto const gathered = _internal::alltoallv_p2p<DataType>(
+            send_buf.data(),
+            gather_send_counts,
+            gather_recv_counts,
+            topology.node_comm
+        );
+
+        std::vector<DataType> scatter_buf;
+        std::vector<size_t> scatter_counts(local_size);
+        if (topology.is_leader()) {
+            size_t const num_nodes = topology.members.size();
+
+            // blocks for each remote node are ordered by local source PE, then destination PE
+            std::vector<size_t> block_offsets(local_counts.size());
+            std::exclusive_scan(
+                local_counts.begin(),
+                local_counts.end(),
+                block_offsets.begin(),
+                size_t{0}
+            );
+
+            std::vector<DataType> pack_buf;
+            std::vector<size_t> pack_counts(num_nodes), block_counts;
+            std::vector<size_t> block_send_counts(num_nodes), block_recv_counts(num_nodes);
+            pack_buf.reserve(gathered.size());
+            block_counts.reserve(local_counts.size());
+            for (size_t node = 0; node != num_nodes; ++node) {
+                size_t const pack_begin = pack_buf.size();
+                for (size_t i = 0; i != local_size; ++i) {
+                    for (auto const dest: topology.members[node]) {
+                        auto const count = local_counts[i * num_pes + dest];
+                        auto const begin = gathered.begin() + block_offsets[i * num_pes + dest];
+                        pack_buf.insert(pack_buf.end(), begin, begin + count);
+                        block_counts.push_back(count);
+                    }
+                }
+                pack_counts[node] = pack_buf.size() - pack_begin;
+                block_send_counts[node] = local_size * topology.members[node].size();
+                block_recv_counts[node] = topology.members[node].size() * local_size;
+            }
+
+            auto const recv_blocks = _internal::alltoallv_p2p<size_t>(
+                block_counts.data(),
+                block_send_counts,
+                block_recv_counts,
+                topology.leader_comm
+            );
+
+            std::vector<size_t> node_recv_counts(num_nodes), node_block_offsets(num_nodes);
+            for (size_t node = 0, offset = 0; node != num_nodes; ++node) {
+                auto const begin = recv_blocks.begin() + offset;
+                auto const end = begin + block_recv_counts[node];
+                node_block_offsets[node] = offset;
+                node_recv_counts[node] = std::accumulate(begin, end, size_t{0});
+                offset += block_recv_counts[node];
+            }
+
+            measuring_tool.addRawCommunication(
+                pack_buf.size() * sizeof(DataType),
+                "alltoallv_node_aggregated"
+            );
+            auto const node_data = _internal::alltoallv_p2p<DataType>(
+                pack_buf.data(),
+                pack_counts,
+                node_recv_counts,
+                topology.leader_comm
+            );
+
+            // reorder the received blocks by destination PE, then by global source rank
+            std::vector<size_t> recv_offsets(recv_blocks.size());
+            std::exclusive_scan(
+                recv_blocks.begin(),
+                recv_blocks.end(),
+                recv_offsets.begin(),
+                size_t{0}
+            );
+
+            scatter_buf.reserve(node_data.size());
+            for (size_t j = 0; j != local_size; ++j) {
+                size_t const scatter_begin = scatter_buf.size();
+                for (size_t source = 0; source != num_pes; ++source) {
+                    auto const node = topology.node_of[source];
+                    auto const local_rank = topology.local_rank_of[source];
+                    auto const block = node_block_offsets[node] + local_rank * local_size + j;
+                    auto const begin = node_data.begin() + recv_offsets[block];
+                    scatter_buf.insert(scatter_buf.end(), begin, begin + recv_blocks[block]);
+                }
+                scatter_counts[j] = scatter_buf.size() - scatter_begin;
+            }
+        }
+
+        std::vector<size_t> scatter_recv_counts(local_size);
+        auto const recv_total = std::accumulate(recv_counts.begin(), recv_counts.end(), size_t{0});
+        scatter_recv_counts.front() = recv_total;
+        return _internal::alltoallv_p2p<DataType>(
+            scatter_buf.data(),
+            scatter_counts,
+            scatter_recv_counts,
+            topology.node_comm
+        );
+    }
+
+    // the node topology is shared by all congruent communicators
+    _internal::NodeTopology const& get_node_topology() const {
+        if (!node_topology_) {
+            auto const comm = this->to_communicator().mpi_communicator();
+            node_topology_ = _internal::get_cached_topology<_internal::NodeTopology>(comm);
+        }
+        return *node_topology_;
+    }
+
+    // the graph communicator is shared by all congruent communicators
+    _internal::NeighborTopology const& get_neighbor_topology() const {
+        if (!neighbor_topology_) {
+            auto const comm = this->to_communicator().mpi_communicator();
+            neighbor_topology_ = _internal::get_cached_topology<_internal::NeighborTopology>(comm);
+        }
+        return *neighbor_topology_;
+    }
+
+    mutable std::shared_ptr<_internal::NodeTopology const> node_topology_;
+    mutable std::shared_ptr<_internal::NeighborTopology const> neighbor_topology_;
 };
 
+// Create the topologies of all exchange communicators of a multi-level sorter up front.
+template <AlltoallvCombinedKind kind, typename Subcommunicators>
+void init_alltoallv_combined(Subcommunicators const& comms) {
+    comms.comm_root().template init_alltoallv_combined<kind>();
+    for (auto const level: comms) {
+        level.comm_exchange.template init_alltoallv_combined<kind>();
+    }
+    comms.comm_final().template init_alltoallv_combined<kind>();
+}
+
 } // namespace mpi
 } // namespace dss_mehnert
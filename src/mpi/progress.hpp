@@ -0,0 +1,88 @@
+// (c) 2023 Pascal Mehnert
+// This code is licensed under BSD 2-Clause License (see LICENSE for details)
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <mpi.h>
+
+namespace dss_mehnert {
+namespace mpi {
+
+// Enters the progress engine of the MPI library, without receiving any message. Many MPI
+// libraries only advance outstanding non-blocking operations during MPI calls.
+inline void poll_progress() {
+    int has_message = 0;
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &has_message, MPI_STATUS_IGNORE);
+}
+
+// Initializes MPI with MPI_THREAD_MULTIPLE if `enabled`, as required by `ProgressThread`, and
+// finalizes it on destruction. Otherwise, MPI is left to be initialized by the caller. Must be
+// constructed before, and thus destroyed after, any kamping environment and progress thread.
+class ThreadMultipleInit {
+public:
+    ThreadMultipleInit(bool const enabled, int& argc, char**& argv) : enabled_{enabled} {
+        if (enabled_) {
+            int provided = MPI_THREAD_SINGLE;
+            MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+        }
+    }
+
+    ThreadMultipleInit(ThreadMultipleInit const&) = delete;
+    ThreadMultipleInit& operator=(ThreadMultipleInit const&) = delete;
+
+    ~ThreadMultipleInit() {
+        if (enabled_) {
+            MPI_Finalize();
+        }
+    }
+
+private:
+    bool enabled_;
+};
+
+// Background thread that polls the MPI library for its lifetime, such that non-blocking
+// operations progress while the calling thread computes. This requires MPI to be initialized
+// with MPI_THREAD_MULTIPLE, otherwise the thread is not started. Must be destroyed before MPI
+// is finalized.
+class ProgressThread {
+public:
+    explicit ProgressThread(
+        bool const enabled, std::chrono::microseconds const interval = std::chrono::microseconds{50}
+    ) {
+        int provided = MPI_THREAD_SINGLE;
+        MPI_Query_thread(&provided);
+        if (enabled && provided == MPI_THREAD_MULTIPLE) {
+            thread_ = std::thread{[this, interval] {
+                while (!stop_.load(std::memory_order_relaxed)) {
+                    poll_progress();
+                    std::this_thread::sleep_for(interval);
+                }
+            }};
+        }
+    }
+
+    ProgressThread(ProgressThread const&) = delete;
+    ProgressThread& operator=(ProgressThread const&) = delete;
+
+    ~ProgressThread() { stop(); }
+
+    bool active() const { return thread_.joinable(); }
+
+    void stop() {
+        if (thread_.joinable()) {
+            stop_.store(true, std::memory_order_relaxed);
+            thread_.join();
+        }
+    }
+
+private:
+    std::atomic<bool> stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace mpi
+} // namespace dss_mehnert
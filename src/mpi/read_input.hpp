@@ -14,6 +14,7 @@
 #include <mpi.h>
 #include <tlx/die/core.hpp>
 
+#include "mpi/big_type.hpp"
 #include "mpi/communicator.hpp"
 
 namespace dss_mehnert {
@@ -40,6 +41,18 @@ shift_left(T* send_data, size_t const send_count, dss_mehnert::Communicator cons
     return recv_data;
 }
 
+// Reads `buf.size()` characters from the current position of the file.
+inline void read_file_chars(MPI_File mpi_file, std::vector<unsigned char>& buf) {
+#if MPI_VERSION >= 4
+    auto const type = kamping::mpi_datatype<unsigned char>();
+    MPI_File_read_c(mpi_file, buf.data(), buf.size(), type, MPI_STATUS_IGNORE);
+#else
+    auto type = dss_schimek::mpi::get_big_type<unsigned char>(buf.size());
+    MPI_File_read(mpi_file, buf.data(), 1, type, MPI_STATUS_IGNORE);
+    MPI_Type_free(&type);
+#endif
+}
+
 inline size_t get_file_size(std::string const& path) {
     std::ifstream in{path, std::ifstream::ate | std::ifstream::binary};
     tlx_die_verbose_unless(in.good(), "file not good");
@@ -80,8 +93,7 @@ inline std::vector<unsigned char> distribute_file_segments(
     MPI_File_seek(mpi_file, offset, MPI_SEEK_SET);
 
     std::vector<unsigned char> result(segment_size);
-    auto const big_type = dss_schimek::mpi::get_big_type<unsigned char>(segment_size);
-    MPI_File_read(mpi_file, result.data(), 1, big_type, MPI_STATUS_IGNORE);
+    read_file_chars(mpi_file, result);
 
     MPI_File_close(&mpi_file);
 
@@ -114,9 +126,8 @@ distribute_file(std::string const& input_path, size_t const max_size, Communicat
 
     MPI_File_seek(mpi_file, offset, MPI_SEEK_SET);
 
-    auto const mpi_type = dss_schimek::mpi::get_big_type<unsigned char>(local_slice_size);
     std::vector<unsigned char> result(local_slice_size);
-    MPI_File_read(mpi_file, result.data(), 1, mpi_type, MPI_STATUS_IGNORE);
+    read_file_chars(mpi_file, result);
 
     MPI_File_close(&mpi_file);
 
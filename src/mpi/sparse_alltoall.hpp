@@ -0,0 +1,162 @@
+// (c) 2023 Pascal Mehnert
+// This code is licensed under BSD 2-Clause License (see LICENSE for details)
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <kamping/mpi_datatype.hpp>
+#include <mpi.h>
+#include <tlx/die.hpp>
+
+#include "util/measuringTool.hpp"
+
+namespace dss_mehnert {
+namespace mpi {
+
+// Number of values sent to or received from a single PE.
+struct MessageCount {
+    int rank;
+    int count;
+};
+
+namespace _internal {
+
+// Both tags are reserved for `sparse_alltoallv`.
+constexpr int sparse_alltoallv_tag = 41328;
+
+inline int delete_sparse_epoch(MPI_Comm, int, void* attribute, void*) {
+    delete static_cast<uint64_t*>(attribute);
+    return MPI_SUCCESS;
+}
+
+// Returns the tag for the next sparse exchange on the given communicator. A PE can only begin
+// exchange i + 2 once all PEs have completed exchange i, hence alternating between two tags
+// suffices to separate consecutive exchanges. The number of exchanges is cached as attribute
+// of the communicator, because the number of calls may differ between communicators.
+inline int next_sparse_alltoallv_tag(MPI_Comm comm) {
+    static int const keyval = [] {
+        int keyval = MPI_KEYVAL_INVALID;
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, delete_sparse_epoch, &keyval, nullptr);
+        return keyval;
+    }();
+
+    void* attribute = nullptr;
+    int has_attribute = 0;
+    MPI_Comm_get_attr(comm, keyval, &attribute, &has_attribute);
+    if (!has_attribute) {
+        attribute = new uint64_t{0};
+        MPI_Comm_set_attr(comm, keyval, attribute);
+    }
+
+    auto& epoch = *static_cast<uint64_t*>(attribute);
+    return sparse_alltoallv_tag + static_cast<int>(epoch++ % 2);
+}
+
+} // namespace _internal
+
+// Personalized all-to-all exchange for sparse communication patterns, using the non-blocking
+// consensus protocol (NBX) of Hoefler et al. Only non-empty messages are sent and receivers
+// need not know their senders in advance, hence neither dense counts nor a global reduction
+// are required. `send_counts` lists the destination of each consecutive range of `send_buf`,
+// each PE at most once. Received values are returned in order of source rank, and
+// `recv_counts` lists the source of each non-empty message in the same order.
+template <typename T, typename Communicator>
+std::vector<T> sparse_alltoallv(
+    std::span<T const> send_buf,
+    std::span<MessageCount const> send_counts,
+    std::vector<MessageCount>& recv_counts,
+    Communicator const& comm
+) {
+    auto const type = kamping::mpi_datatype<T>();
+    auto const comm_mpi = comm.mpi_communicator();
+    int const rank = comm.rank();
+    int const tag = _internal::next_sparse_alltoallv_tag(comm_mpi);
+
+    std::vector<std::pair<int, std::vector<T>>> messages;
+    std::vector<MPI_Request> requests;
+
+    size_t offset = 0, send_volume = 0;
+    for (auto const [dest, count]: send_counts) {
+        tlx_die_verbose_if(count < 0 || dest < 0 || dest >= static_cast<int>(comm.size()),
+                           "invalid message count for PE " << dest);
+        if (dest == rank && count > 0) {
+            auto const begin = send_buf.begin() + offset;
+            messages.emplace_back(dest, std::vector<T>(begin, begin + count));
+        } else if (count > 0) {
+            auto& request = requests.emplace_back();
+            MPI_Issend(send_buf.data() + offset, count, type, dest, tag, comm_mpi, &request);
+            send_volume += count * sizeof(T);
+        }
+        offset += count;
+    }
+
+    // receive until all local sends have been matched and all PEs have reached the barrier
+    bool barrier_active = false;
+    MPI_Request barrier_request;
+    while (true) {
+        int has_message = 0;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, tag, comm_mpi, &has_message, &status);
+        if (has_message) {
+            int count = 0;
+            MPI_Get_count(&status, type, &count);
+            auto& [source, values] = messages.emplace_back(status.MPI_SOURCE, count);
+            MPI_Recv(values.data(), count, type, source, tag, comm_mpi, MPI_STATUS_IGNORE);
+        }
+
+        if (barrier_active) {
+            int is_done = 0;
+            MPI_Test(&barrier_request, &is_done, MPI_STATUS_IGNORE);
+            if (is_done) {
+                break;
+            }
+        } else {
+            int is_sent = 0;
+            MPI_Testall(requests.size(), requests.data(), &is_sent, MPI_STATUSES_IGNORE);
+            if (is_sent) {
+                MPI_Ibarrier(comm_mpi, &barrier_request);
+                barrier_active = true;
+            }
+        }
+    }
+
+    auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+    measuring_tool.addRawCommunication(send_volume, "sparse_alltoallv");
+
+    std::stable_sort(messages.begin(), messages.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    size_t recv_size = 0;
+    recv_counts.clear();
+    for (auto const& [source, values]: messages) {
+        recv_size += values.size();
+        recv_counts.push_back({source, static_cast<int>(values.size())});
+    }
+
+    std::vector<T> recv_buf;
+    recv_buf.reserve(recv_size);
+    for (auto const& [source, values]: messages) {
+        recv_buf.insert(recv_buf.end(), values.begin(), values.end());
+    }
+    return recv_buf;
+}
+
+template <typename T, typename Communicator>
+std::vector<T> sparse_alltoallv(
+    std::span<T const> send_buf,
+    std::span<MessageCount const> send_counts,
+    Communicator const& comm
+) {
+    std::vector<MessageCount> recv_counts;
+    return sparse_alltoallv(send_buf, send_counts, recv_counts, comm);
+}
+
+} // namespace mpi
+} // namespace dss_mehnert
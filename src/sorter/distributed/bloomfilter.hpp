@@ -5,14 +5,23 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <numeric>
 #include <random>
+#include <span>
+#include <string_view>
 #include <type_traits>
 
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
 #include <ips4o.hpp>
 #include <kamping/collectives/allreduce.hpp>
 #include <kamping/collectives/alltoall.hpp>
@@ -28,6 +37,7 @@
 
 #include "hash/xxhash.hpp"
 #include "mpi/communicator.hpp"
+#include "mpi/sparse_alltoall.hpp"
 #include "sorter/distributed/multi_level.hpp"
 #include "util/measuringTool.hpp"
 
@@ -72,6 +82,110 @@ struct XXHasher {
     }
 };
 
+namespace _internal {
+
+// 32-bit hash values are moved to the upper half, such that the range of hash values used to
+// assign hashes to PEs is still spread evenly.
+inline hash_t spread_hash(uint32_t const hash) noexcept {
+    return (static_cast<hash_t>(hash) << 32) | hash;
+}
+
+inline uint32_t crc32c(unsigned char const* str, size_t length) noexcept {
+    uint32_t crc = ~uint32_t{0};
+#if defined(__SSE4_2__)
+    uint64_t crc_word = crc;
+    for (; length >= sizeof(uint64_t); str += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, str, sizeof(uint64_t));
+        crc_word = _mm_crc32_u64(crc_word, word);
+    }
+    crc = static_cast<uint32_t>(crc_word);
+    for (; length > 0; ++str, --length) {
+        crc = _mm_crc32_u8(crc, *str);
+    }
+#else
+    for (; length > 0; ++str, --length) {
+        crc ^= *str;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+        }
+    }
+#endif
+    return ~crc;
+}
+
+} // namespace _internal
+
+struct XXHasher32 {
+    static inline hash_t hash(unsigned char const* str, size_t length) noexcept {
+        return _internal::spread_hash(xxh::xxhash<32>(str, length));
+    }
+};
+
+struct Crc32cHasher {
+    static inline hash_t hash(unsigned char const* str, size_t length) noexcept {
+        return _internal::spread_hash(_internal::crc32c(str, length));
+    }
+
+#if defined(__SSE4_2__)
+    // Strings of equal length are hashed in lockstep, such that the latency of the CRC
+    // instruction is hidden by interleaving independent lanes.
+    static void hash_batch(
+        std::span<unsigned char const* const> strs, size_t const length, hash_t* dest
+    ) noexcept {
+        constexpr size_t lanes = 4;
+        constexpr size_t word_size = sizeof(uint64_t);
+
+        size_t i = 0;
+        for (; i + lanes <= strs.size(); i += lanes) {
+            std::array<uint64_t, lanes> crc;
+            crc.fill(~uint32_t{0});
+
+            size_t offset = 0;
+            for (; offset + word_size <= length; offset += word_size) {
+                for (size_t lane = 0; lane != lanes; ++lane) {
+                    uint64_t word;
+                    std::memcpy(&word, strs[i + lane] + offset, word_size);
+                    crc[lane] = _mm_crc32_u64(crc[lane], word);
+                }
+            }
+            for (size_t lane = 0; lane != lanes; ++lane) {
+                auto lane_crc = static_cast<uint32_t>(crc[lane]);
+                for (size_t j = offset; j != length; ++j) {
+                    lane_crc = _mm_crc32_u8(lane_crc, strs[i + lane][j]);
+                }
+                dest[i + lane] = _internal::spread_hash(~lane_crc);
+            }
+        }
+        for (; i != strs.size(); ++i) {
+            dest[i] = hash(strs[i], length);
+        }
+    }
+#endif
+};
+
+enum class HashKind { xxhash64, xxhash32, siphash, crc32c };
+
+inline std::string_view get_name(HashKind const kind) {
+    switch (kind) {
+        case HashKind::xxhash64:
+            return "xxhash64";
+        case HashKind::xxhash32:
+            return "xxhash32";
+        case HashKind::siphash:
+            return "siphash";
+        case HashKind::crc32c:
+            return "crc32c";
+    }
+    tlx_die("unknown hash function");
+}
+
+// Whether the hash policy can hash the first `length` characters of multiple strings at once.
+template <typename HashPolicy>
+concept HasHashBatch = requires(
+    std::span<unsigned char const* const> strs, size_t const length, hash_t* dest
+) { HashPolicy::hash_batch(strs, length, dest); };
+
 struct HashRange {
     hash_t lower;
     hash_t upper;
@@ -264,28 +378,20 @@ inline RemoteDuplicates compute_duplicates(
     return result;
 }
 
-inline std::optional<std::vector<int>> send_duplicates(
+// The duplicate matrix is sparse, hence the indices are sent using a sparse exchange.
+inline std::vector<int> send_duplicates(
     std::vector<int> const& duplicates,
     std::vector<int> const& send_counts,
-    std::vector<int> const& send_displs,
-    Communicator const& comm_send,
-    Communicator const& comm_global
+    Communicator const& comm
 ) {
-    auto any_global_dups = comm_global.allreduce_single(
-        kamping::send_buf({!duplicates.empty()}),
-        kamping::op(std::logical_or<>{})
-    );
-
-    if (any_global_dups) {
-        auto result = comm_send.alltoallv(
-            kamping::send_buf(duplicates),
-            kamping::send_counts(send_counts),
-            kamping::send_displs(send_displs)
-        );
-        return result.extract_recv_buffer();
-    } else {
-        return {};
+    std::vector<mpi::MessageCount> counts;
+    for (int rank = 0; auto const count: send_counts) {
+        if (count > 0) {
+            counts.push_back({rank, count});
+        }
+        ++rank;
     }
+    return mpi::sparse_alltoallv<int>(duplicates, counts, comm);
 }
 
 } // namespace _internal
@@ -300,9 +406,15 @@ class BloomFilter {
 public:
     explicit BloomFilter(size_t size) : hash_values_(reuse_hash_values ? size : 0) {}
 
+    // If at most `max_tail_candidates` candidates remain globally, doubling stops early and
+    // the remaining candidates use their full length as distinguishing prefix. This avoids
+    // further rounds (and their global synchronization) for a small tail of long prefixes.
     template <typename StringPtr, typename Subcommunicators>
     std::vector<size_t> compute_distinguishing_prefixes(
-        StringPtr const& strptr, Subcommunicators const& comms, size_t const start_depth
+        StringPtr const& strptr,
+        Subcommunicators const& comms,
+        size_t const start_depth,
+        size_t const max_tail_candidates = 0
     ) {
         auto const& ss = strptr.active();
         std::vector<size_t> results(ss.size());
@@ -314,13 +426,19 @@ public:
         for (size_t i = start_depth * 2; i < std::numeric_limits<size_t>::max(); i *= 2) {
             measuring_tool_.add(candidates.size(), "bloomfilter_num_candidates");
             measuring_tool_.start("bloomfilter_allreduce");
-            auto const all_empty = comms.comm_root().allreduce_single(
-                kamping::send_buf({candidates.empty()}),
-                kamping::op(std::logical_and<>{})
+            auto const num_candidates = comms.comm_root().allreduce_single(
+                kamping::send_buf(candidates.size()),
+                kamping::op(std::plus<>{})
             );
             measuring_tool_.stop("bloomfilter_allreduce");
 
-            if (all_empty) {
+            if (num_candidates == 0) {
+                break;
+            } else if (num_candidates <= max_tail_candidates) {
+                measuring_tool_.add(candidates.size(), "bloomfilter_tail_candidates");
+                for (auto const& candidate: candidates) {
+                    results[candidate] = ss.get_length(ss.at(candidate));
+                }
                 break;
             }
 
@@ -357,9 +475,8 @@ public:
 
         measuring_tool_.start("bloomfilter_find_remote_duplicates");
         HashRange const hash_range{0, std::numeric_limits<hash_t>::max()};
-        auto const remote_dups = static_cast<Derived&>(*this)
-                                     .find_remote_duplicates(hash_idx_pairs, hash_range)
-                                     .value_or(std::vector<int>{});
+        auto const remote_dups =
+            static_cast<Derived&>(*this).find_remote_duplicates(hash_idx_pairs, hash_range);
         measuring_tool_.stop("bloomfilter_find_remote_duplicates");
 
         measuring_tool_.start("bloomfilter_merge_duplicates");
@@ -388,37 +505,65 @@ private:
         std::vector<size_t> eos_candidates;
     };
 
+    // Strings whose hash value is computed in a batch, after all candidates have been scanned.
+    // Strings that share their prefix with the preceding string reuse its hash value. Policies
+    // without batch interface hash each string immediately, such that no characters are stored.
+    struct HashJobs {
+        std::vector<unsigned char const*> chars;
+        std::vector<std::pair<size_t, size_t>> reused;
+    };
+
+    static void push_hash(
+        GeneratedHashPairs& result,
+        HashJobs& jobs,
+        size_t const index,
+        unsigned char const* chars,
+        size_t const length
+    ) {
+        if constexpr (HasHashBatch<HashPolicy>) {
+            result.hash_idx_pairs.emplace_back(0, index);
+            jobs.chars.push_back(chars);
+        } else {
+            result.hash_idx_pairs.emplace_back(HashPolicy::hash(chars, length), index);
+        }
+    }
+
+    static void push_reused_hash(GeneratedHashPairs& result, HashJobs& jobs, size_t const index) {
+        if constexpr (reuse_hash_values) {
+            jobs.reused.emplace_back(index, result.hash_idx_pairs.size() - 1);
+        }
+    }
+
     template <typename StringSet, typename LcpIter>
     GeneratedHashPairs
     generate_hash_pairs(StringSet const& ss, size_t const depth, LcpIter const lcps) {
         GeneratedHashPairs result;
+        HashJobs jobs;
         if (!ss.empty()) {
             result.eos_candidates.reserve(ss.size());
             result.hash_idx_pairs.reserve(ss.size());
             result.lcp_duplicates.reserve(ss.size());
+            if constexpr (HasHashBatch<HashPolicy>) {
+                jobs.chars.reserve(ss.size());
+            }
 
-            hash_t curr_hash = 0;
             size_t candidate = 0;
             for (auto it = ss.begin(); it != ss.end(); ++it, ++candidate) {
                 if (depth > ss.get_length(ss[it])) {
                     result.eos_candidates.push_back(candidate);
-                } else {
-                    if (lcps[candidate] >= depth) {
-                        // running hash value does not have to be updated here
-                        result.lcp_duplicates.push_back(candidate);
-                        if (result.hash_idx_pairs.back().string_index + 1 == candidate) {
-                            result.hash_idx_pairs.back().is_lcp_root = true;
-                        }
-                    } else {
-                        curr_hash = HashPolicy::hash(ss.get_chars(ss[it], 0), depth);
-                        result.hash_idx_pairs.emplace_back(curr_hash, candidate);
-                    }
-                    if constexpr (reuse_hash_values) {
-                        hash_values_[candidate] = curr_hash;
+                } else if (lcps[candidate] >= depth) {
+                    // running hash value does not have to be updated here
+                    result.lcp_duplicates.push_back(candidate);
+                    if (result.hash_idx_pairs.back().string_index + 1 == candidate) {
+                        result.hash_idx_pairs.back().is_lcp_root = true;
                     }
+                    push_reused_hash(result, jobs, candidate);
+                } else {
+                    push_hash(result, jobs, candidate, ss.get_chars(ss[it], 0), depth);
                 }
             }
         }
+        compute_hashes(result.hash_idx_pairs, jobs, depth, [](auto const&) { return 0; });
         return result;
     }
 
@@ -429,46 +574,81 @@ private:
         size_t const depth,
         LcpIter const lcps
     ) {
+        size_t const half_depth = depth / 2;
+
         GeneratedHashPairs result;
+        HashJobs jobs;
         if (!candidates.empty()) {
-            size_t const half_depth = depth / 2;
-
             result.eos_candidates.reserve(candidates.size());
             result.hash_idx_pairs.reserve(candidates.size());
             result.lcp_duplicates.reserve(candidates.size());
+            if constexpr (HasHashBatch<HashPolicy>) {
+                jobs.chars.reserve(candidates.size());
+            }
 
-            hash_t curr_hash = 0;
             for (auto prev = candidates.front(); auto const& curr: candidates) {
                 auto const& curr_str = ss.at(curr);
 
                 if (depth > ss.get_length(curr_str)) {
                     result.eos_candidates.push_back(curr);
-                } else {
-                    if (prev + 1 == curr && lcps[curr] >= depth) {
-                        // running hash value does not have to be updated here
-                        result.lcp_duplicates.push_back(curr);
-                        if (result.hash_idx_pairs.back().string_index + 1 == curr) {
-                            result.hash_idx_pairs.back().is_lcp_root = true;
-                        }
-                    } else {
-                        if constexpr (reuse_hash_values) {
-                            auto const chars = ss.get_chars(curr_str, half_depth);
-                            curr_hash = hash_values_[curr] ^ HashPolicy::hash(chars, half_depth);
-                        } else {
-                            curr_hash = HashPolicy::hash(ss.get_chars(curr_str, 0), depth);
-                        }
-                        result.hash_idx_pairs.emplace_back(curr_hash, curr);
-                    }
-                    if constexpr (reuse_hash_values) {
-                        hash_values_[curr] = curr_hash;
+                    continue;
+                }
+
+                if (prev + 1 == curr && lcps[curr] >= depth) {
+                    // running hash value does not have to be updated here
+                    result.lcp_duplicates.push_back(curr);
+                    if (result.hash_idx_pairs.back().string_index + 1 == curr) {
+                        result.hash_idx_pairs.back().is_lcp_root = true;
                     }
-                    prev = curr;
+                    push_reused_hash(result, jobs, curr);
+                } else if constexpr (reuse_hash_values) {
+                    auto const chars = ss.get_chars(curr_str, half_depth);
+                    push_hash(result, jobs, curr, chars, half_depth);
+                } else {
+                    push_hash(result, jobs, curr, ss.get_chars(curr_str, 0), depth);
                 }
+                prev = curr;
             }
         }
+
+        if constexpr (reuse_hash_values) {
+            // the hash of the first half of each prefix is known from the previous round
+            auto get_prev_hash = [&](size_t const index) { return hash_values_[index]; };
+            compute_hashes(result.hash_idx_pairs, jobs, half_depth, get_prev_hash);
+        } else {
+            compute_hashes(result.hash_idx_pairs, jobs, depth, [](auto const&) { return 0; });
+        }
         return result;
     }
 
+    template <typename PrevHash>
+    void compute_hashes(
+        std::vector<HashStringIndex>& hash_idx_pairs,
+        HashJobs const& jobs,
+        size_t const length,
+        PrevHash&& get_prev_hash
+    ) {
+        if constexpr (HasHashBatch<HashPolicy>) {
+            std::vector<hash_t> hashes(jobs.chars.size());
+            HashPolicy::hash_batch(jobs.chars, length, hashes.data());
+            for (size_t i = 0; i != hash_idx_pairs.size(); ++i) {
+                hash_idx_pairs[i].hash_value = hashes[i];
+            }
+        }
+
+        for (auto& pair: hash_idx_pairs) {
+            pair.hash_value ^= get_prev_hash(pair.string_index);
+            if constexpr (reuse_hash_values) {
+                hash_values_[pair.string_index] = pair.hash_value;
+            }
+        }
+        if constexpr (reuse_hash_values) {
+            for (auto const& [candidate, source]: jobs.reused) {
+                hash_values_[candidate] = hash_idx_pairs[source].hash_value;
+            }
+        }
+    }
+
     static std::vector<size_t> get_local_duplicates(std::vector<HashStringIndex>& local_values) {
         std::vector<size_t> local_duplicates;
         if (!local_values.empty()) {
@@ -594,7 +774,7 @@ public:
 private:
     Communicator const& comm_;
 
-    std::optional<std::vector<int>> find_remote_duplicates(
+    std::vector<int> find_remote_duplicates(
         std::vector<HashStringIndex> const& hash_str_pairs, HashRange const hash_range
     ) {
         auto& measuring_tool = measurement::MeasuringTool::measuringTool();
@@ -620,13 +800,8 @@ private:
         measuring_tool.stop("bloomfilter_compute_remote_duplicates");
 
         measuring_tool.start("bloomfilter_send_indices");
-        auto remote_dups = _internal::send_duplicates(
-            result.duplicates,
-            result.send_counts,
-            result.send_displs,
-            comm_,
-            comm_
-        );
+        auto remote_dups =
+            _internal::send_duplicates(result.duplicates, result.send_counts, comm_);
         measuring_tool.stop("bloomfilter_send_indices");
 
         return remote_dups;
@@ -644,14 +819,12 @@ public:
     template <typename Subcommunicators>
     MultiLevel(Subcommunicators const& comms, size_t const size)
         : BloomFilterBase{size},
-          comm_root_{comms.comm_root()},
           comm_grid_{comms} {}
 
 private:
-    Communicator const& comm_root_;
     multi_level::GridCommunicators<Communicator> comm_grid_;
 
-    std::optional<std::vector<int>> find_remote_duplicates(
+    std::vector<int> find_remote_duplicates(
         std::vector<HashStringIndex> const& hash_str_pairs, HashRange const hash_range
     ) {
         auto& measuring_tool = measurement::MeasuringTool::measuringTool();
@@ -668,7 +841,7 @@ private:
     }
 
     template <typename CommIt, typename T>
-    std::optional<std::vector<int>> find_remote_duplicates_(
+    std::vector<int> find_remote_duplicates_(
         CommIt const comm_first,
         CommIt const comm_last,
         std::vector<T> const& hash_pairs,
@@ -677,7 +850,7 @@ private:
         auto& measuring_tool = measurement::MeasuringTool::measuringTool();
 
         assert(comm_first != comm_last);
-        auto const& comm = *comm_first;
+        Communicator const& comm = *comm_first;
 
         auto hash_values = _internal::extract_hash_values(hash_pairs);
         auto recv_data = _internal::send_hash_values(hash_values, hash_range, comm);
@@ -701,24 +874,14 @@ private:
             measuring_tool.stop("bloomfilter_compute_remote_duplicates");
 
             measuring_tool.start("bloomfilter_send_indices");
-            return _internal::send_duplicates(
-                result.duplicates,
-                result.send_counts,
-                result.send_displs,
-                comm,
-                comm_root_
-            );
+            return _internal::send_duplicates(result.duplicates, result.send_counts, comm);
 
         } else {
             auto bucket = hash_range.bucket(comm.rank(), comm.size());
             auto duplicates =
                 find_remote_duplicates_(comm_first + 1, comm_last, hash_rank_pairs, bucket);
-            if (duplicates) {
-                auto& global_offsets = recv_data.global_offsets;
-                return send_dups_recursive(hash_rank_pairs, *duplicates, global_offsets, comm);
-            } else {
-                return {};
-            }
+            auto& global_offsets = recv_data.global_offsets;
+            return send_dups_recursive(hash_rank_pairs, duplicates, global_offsets, comm);
         }
     }
 
@@ -735,7 +898,6 @@ private:
 
         std::vector<int> offsets{send_counts};
         std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), 0);
-        std::vector<int> send_displs{offsets};
 
         std::vector<int> remote_idxs(duplicates.size());
         auto counters = std::move(global_offsets);
@@ -747,12 +909,7 @@ private:
             remote_idxs[offsets[rank]++] = counters[rank];
         }
 
-        auto result = comm.alltoallv(
-            kamping::send_buf(remote_idxs),
-            kamping::send_counts(send_counts),
-            kamping::send_displs(send_displs)
-        );
-        return result.extract_recv_buffer();
+        return _internal::send_duplicates(remote_idxs, send_counts, comm);
     }
 };
 
@@ -0,0 +1,181 @@
+// (c) 2023 Pascal Mehnert
+// This code is licensed under BSD 2-Clause License (see LICENSE for details)
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <kamping/collectives/allgather.hpp>
+#include <kamping/collectives/alltoall.hpp>
+#include <kamping/named_parameters.hpp>
+
+#include "merge/lcp_merge.hpp"
+#include "mpi/alltoall_strings.hpp"
+#include "mpi/communicator.hpp"
+#include "sorter/distributed/merging.hpp"
+#include "sorter/distributed/misc.hpp"
+#include "sorter/distributed/permutation.hpp"
+#include "sorter/local/local_sort.hpp"
+#include "strings/stringcontainer.hpp"
+#include "strings/stringset.hpp"
+#include "util/measuringTool.hpp"
+
+namespace dss_mehnert {
+namespace sorter {
+
+using mpi::AlltoallStringsConfig;
+
+// Inserts batches of new strings into a string set that is already sorted across all PEs.
+// The first string on each PE acts as splitter, such that each batch only has to be sorted
+// locally, exchanged once, and merged into the existing strings.
+template <AlltoallStringsConfig config>
+class IncrementalMergeSort {
+public:
+    IncrementalMergeSort() = default;
+
+    explicit IncrementalMergeSort(local_sort::LocalSorter local_sorter)
+        : local_sorter_{local_sorter} {}
+
+    // The existing set is required to be globally sorted and to have a valid LCP array.
+    // If it is empty on all PEs, the entire batch is sent to the root PE.
+    template <typename StringSet>
+    void insert(
+        StringLcpContainer<StringSet>& container,
+        StringLcpContainer<StringSet>&& batch,
+        Communicator const& comm
+    )
+        requires(StringSet::has_length && !StringSet::is_indexed)
+    {
+        measuring_tool_.setPhase("incremental_insert");
+        measuring_tool_.add(batch.size(), "batch_size");
+
+        measuring_tool_.start("sort_batch");
+        local_sorter_.sort(batch.make_string_lcp_ptr());
+        measuring_tool_.stop("incremental_insert", "sort_batch", comm);
+
+        if (comm.size() > 1) {
+            measuring_tool_.start("compute_partition");
+            auto send_counts = compute_send_counts(container, batch, comm);
+            measuring_tool_.stop("compute_partition");
+
+            measuring_tool_.start("exchange_and_merge");
+            exchange_and_merge(batch, send_counts, comm);
+            measuring_tool_.stop("exchange_and_merge");
+        }
+
+        measuring_tool_.start("merge_into_set");
+        merge_into(container, batch);
+        measuring_tool_.stop("merge_into_set");
+
+        measuring_tool_.add(container.size(), "local_num_strings");
+    }
+
+private:
+    using MeasuringTool = measurement::MeasuringTool;
+    MeasuringTool& measuring_tool_ = MeasuringTool::measuringTool();
+
+    local_sort::LocalSorter local_sorter_;
+
+    template <typename StringSet>
+    std::vector<size_t> compute_send_counts(
+        StringLcpContainer<StringSet>& container,
+        StringLcpContainer<StringSet>& batch,
+        Communicator const& comm
+    ) {
+        using Char = StringSet::Char;
+        using SplitterSet = dss_schimek::StringSet<Char, dss_schimek::Length>;
+
+        // the first string of every non-empty PE (except the first one) is used as splitter
+        uint8_t const is_empty = container.empty();
+        auto empty_result = comm.allgather(kamping::send_buf({is_empty}));
+        auto const empty_flags = empty_result.extract_recv_buffer();
+
+        std::vector<size_t> ranks;
+        for (size_t rank = 0; rank != comm.size(); ++rank) {
+            if (!empty_flags[rank]) {
+                ranks.push_back(rank);
+            }
+        }
+
+        std::vector<size_t> send_counts(comm.size(), 0);
+        if (ranks.empty()) {
+            send_counts.front() = batch.size();
+            return send_counts;
+        }
+
+        std::vector<Char> first_string;
+        if (!container.empty() && comm.rank() != ranks.front()) {
+            first_string = container.get_raw_string(0);
+        }
+        auto splitter_result = comm.allgatherv(kamping::send_buf(first_string));
+        StringContainer<SplitterSet> splitters{splitter_result.extract_recv_buffer()};
+        assert_equal(splitters.size() + 1, ranks.size());
+
+        auto const interval_sizes =
+            compute_interval_binary(batch.make_string_set(), splitters.make_string_set());
+        for (size_t i = 0; i != ranks.size(); ++i) {
+            send_counts[ranks[i]] = interval_sizes[i];
+        }
+        return send_counts;
+    }
+
+    template <typename StringSet>
+    void exchange_and_merge(
+        StringLcpContainer<StringSet>& batch,
+        std::vector<size_t> const& send_counts,
+        Communicator const& comm
+    ) {
+        std::vector<size_t> recv_counts;
+        comm.alltoall(kamping::send_buf(send_counts), kamping::recv_buf(recv_counts));
+        comm.template alltoall_strings<config, NoPermutation>(batch, send_counts, recv_counts);
+
+        std::vector<size_t> merge_counts = recv_counts;
+        std::erase(merge_counts, 0);
+
+        if (auto& lcps = batch.lcps(); !batch.empty()) {
+            for (size_t i = 0, offset = 0; i != merge_counts.size(); ++i) {
+                lcps[offset] = 0;
+                offset += merge_counts[i];
+            }
+        }
+
+        constexpr bool is_compressed = config.compress_prefixes;
+        auto const result = merge::choose_merge<is_compressed>(batch, merge_counts);
+        if constexpr (is_compressed) {
+            batch.extend_prefix(result.saved_lcps);
+        }
+    }
+
+    template <typename StringSet>
+    void merge_into(StringLcpContainer<StringSet>& container, StringLcpContainer<StringSet>& batch) {
+        using String = StringSet::String;
+
+        if (batch.empty()) {
+            return;
+        } else if (container.empty()) {
+            swap(container, batch);
+            return;
+        }
+
+        size_t const total_size = container.size() + batch.size();
+        std::vector<String> strings(total_size);
+        std::vector<size_t> lcps(total_size);
+
+        using StringLcpPtr = StringLcpContainer<StringSet>::StringLcpPtr;
+        StringLcpPtr const dest{StringSet{strings.data(), strings.data() + total_size}, lcps.data()};
+        container.lcps().front() = 0;
+        batch.lcps().front() = 0;
+        merge::lcp_merge(container.make_string_lcp_ptr(), batch.make_string_lcp_ptr(), dest);
+
+        // the merged strings still reference both character arrays
+        container.set(std::move(strings));
+        container.set(std::move(lcps));
+        container.make_contiguous();
+        batch.delete_all();
+    }
+};
+
+} // namespace sorter
+} // namespace dss_mehnert
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <algorithm>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <numeric>
@@ -15,13 +16,13 @@
 #include <utility>
 #include <vector>
 
+#include <kamping/collectives/allreduce.hpp>
 #include <kamping/collectives/alltoall.hpp>
 #include <kamping/collectives/bcast.hpp>
 #include <kamping/collectives/reduce.hpp>
 #include <kamping/mpi_ops.hpp>
 #include <kamping/named_parameters.hpp>
 #include <tlx/die.hpp>
-#include <tlx/sort/strings/radix_sort.hpp>
 #include <tlx/sort/strings/string_ptr.hpp>
 
 #include "mpi/alltoall_strings.hpp"
@@ -30,6 +31,7 @@
 #include "sorter/distributed/multi_level.hpp"
 #include "sorter/distributed/permutation.hpp"
 #include "sorter/distributed/sample.hpp"
+#include "sorter/local/local_sort.hpp"
 #include "util/measuringTool.hpp"
 
 namespace dss_mehnert {
@@ -41,10 +43,13 @@ template <AlltoallStringsConfig config, typename RedistributionPolicy, typename
 class BaseDistributedMergeSort : protected PartitionPolicy, protected RedistributionPolicy {
 public:
     explicit BaseDistributedMergeSort(
-        PartitionPolicy partition, RedistributionPolicy redistribution
+        PartitionPolicy partition,
+        RedistributionPolicy redistribution,
+        local_sort::LocalSorter local_sorter = {}
     )
         : PartitionPolicy{std::move(partition)},
-          RedistributionPolicy{std::move(redistribution)} {}
+          RedistributionPolicy{std::move(redistribution)},
+          local_sorter_{local_sorter} {}
 
 protected:
     using Subcommunicators = RedistributionPolicy::Subcommunicators;
@@ -53,13 +58,18 @@ protected:
     using MeasuringTool = measurement::MeasuringTool;
     MeasuringTool& measuring_tool_ = MeasuringTool::measuringTool();
 
+    local_sort::LocalSorter local_sorter_;
+
+    bool partition_splits_ties() const { return PartitionPolicy::splits_ties(); }
+
     template <typename StringSet, typename PermutationBuilder>
         requires(StringSet::has_length)
     void sort(
         StringLcpContainer<StringSet>& container,
         Subcommunicators const& comms,
         size_t const splitter_max_length,
-        PermutationBuilder& builder
+        PermutationBuilder& builder,
+        std::vector<typename StringSet::Char> presampled = {}
     ) {
         auto const& comm_root = comms.comm_root();
 
@@ -70,7 +80,8 @@ protected:
                 this->measuring_tool_.start("sort_globally", "partial_sorting");
                 auto const& comm = level.comm_exchange;
                 auto const strptr = container.make_string_lcp_ptr();
-                auto const send_counts = compute_sorted_send_counts(strptr, arg, level);
+                auto const send_counts =
+                    compute_sorted_send_counts(strptr, arg, level, std::exchange(presampled, {}));
                 exchange_and_merge(container, send_counts, arg, builder, comm);
                 this->measuring_tool_.stop("sort_globally", "partial_sorting", comm_root);
                 this->measuring_tool_.setRound(++round);
@@ -81,7 +92,8 @@ protected:
             this->measuring_tool_.start("sort_globally", "final_sorting");
             auto const strptr = container.make_string_lcp_ptr();
             auto const& comm = comms.comm_final();
-            auto const send_counts = compute_sorted_send_counts(strptr, arg, comm);
+            auto const send_counts =
+                compute_sorted_send_counts(strptr, arg, comm, std::move(presampled));
             exchange_and_merge(container, send_counts, arg, builder, comm);
             this->measuring_tool_.stop("sort_globally", "final_sorting", comm_root);
         }
@@ -89,21 +101,55 @@ protected:
         this->measuring_tool_.setRound(0);
     }
 
+    // Draw the sample for the first level from the unsorted local strings.
+    template <typename StringSet>
+    std::vector<typename StringSet::Char>
+    presample(StringSet const& ss, Subcommunicators const& comms) const {
+        // the average LCP used to bound the splitter length is only known after sorting,
+        // hence the bound uses the average string length, which is never smaller
+        size_t local_length_sum = 0;
+        for (auto const& str: ss) {
+            local_length_sum += ss.get_length(str);
+        }
+        auto result = comms.comm_root().allreduce(
+            kamping::send_buf({local_length_sum, ss.size()}),
+            kamping::op(kamping::ops::plus<>{})
+        );
+        auto const global_sum = result.extract_recv_buffer();
+        auto const avg_length = global_sum[0] / std::max(size_t{1}, global_sum[1]);
+
+        sample::MaxLength const arg{100 * (avg_length + 5)};
+        return with_first_level(comms, [&](size_t const num_partitions, auto const& comm) {
+            return PartitionPolicy::presample(ss, num_partitions, arg, comm);
+        });
+    }
+
+    // Choose the splitters for the first level from a sample drawn by `presample`.
+    template <typename Char>
+    std::vector<Char>
+    select_presampled(std::vector<Char>&& sample, Subcommunicators const& comms) const {
+        return with_first_level(comms, [&](size_t const num_partitions, auto const& comm) {
+            return PartitionPolicy::select_presampled(std::move(sample), num_partitions, comm);
+        });
+    }
+
     template <typename StringPtr, typename ExtraArg>
     std::vector<size_t> compute_sorted_send_counts(
         StringPtr const& strptr,
         ExtraArg const extra_arg,
-        multi_level::Level<Communicator> const& level
+        multi_level::Level<Communicator> const& level,
+        std::vector<typename StringPtr::StringSet::Char> presampled = {}
     ) {
         measuring_tool_.add(level.num_groups(), "num_groups");
         measuring_tool_.add(level.group_size(), "group_size");
 
         measuring_tool_.start("sort_globally", "compute_partition");
-        auto const interval_sizes = PartitionPolicy::compute_partition(
+        auto const interval_sizes = compute_intervals(
             strptr,
             level.num_groups(),
             extra_arg,
-            level.comm_orig
+            level.comm_orig,
+            std::move(presampled)
         );
         measuring_tool_.stop("sort_globally", "compute_partition");
 
@@ -122,14 +168,17 @@ protected:
 
     template <typename StringPtr, typename ExtraArg>
     std::vector<size_t> compute_sorted_send_counts(
-        StringPtr const& strptr, ExtraArg const extra_arg, Communicator const& comm
+        StringPtr const& strptr,
+        ExtraArg const extra_arg,
+        Communicator const& comm,
+        std::vector<typename StringPtr::StringSet::Char> presampled = {}
     ) {
         measuring_tool_.add(1, "num_groups");
         measuring_tool_.add(comm.size(), "group_size");
 
         measuring_tool_.start("sort_globally", "compute_partition");
         auto const send_counts =
-            PartitionPolicy::compute_partition(strptr, comm.size(), extra_arg, comm);
+            compute_intervals(strptr, comm.size(), extra_arg, comm, std::move(presampled));
         measuring_tool_.stop("sort_globally", "compute_partition");
 
         measuring_tool_.start("sort_globally", "redistribute_strings");
@@ -138,6 +187,43 @@ protected:
         return send_counts;
     }
 
+    // Uses the presampled splitters if present, otherwise computes a new partition.
+    template <typename StringPtr, typename ExtraArg>
+    std::vector<size_t> compute_intervals(
+        StringPtr const& strptr,
+        size_t const num_partitions,
+        ExtraArg const extra_arg,
+        Communicator const& comm,
+        std::vector<typename StringPtr::StringSet::Char>&& presampled
+    ) {
+        using Char = StringPtr::StringSet::Char;
+        using SplitterSet = dss_schimek::StringSet<Char, dss_schimek::Length>;
+
+        if (presampled.empty()) {
+            return PartitionPolicy::compute_partition(strptr, num_partitions, extra_arg, comm);
+        }
+
+        StringContainer<SplitterSet> const splitters{std::move(presampled)};
+        auto const splitter_set = splitters.make_string_set();
+        auto interval_sizes = PartitionPolicy::splits_ties()
+                                  ? compute_interval_binary(strptr.active(), splitter_set)
+                                  : compute_interval_upper_bound(strptr.active(), splitter_set);
+        interval_sizes.resize(num_partitions, 0);
+        return interval_sizes;
+    }
+
+    template <typename Callback>
+    static auto with_first_level(Subcommunicators const& comms, Callback&& callback) {
+        if constexpr (!Subcommunicators::is_single_level) {
+            if (comms.begin() != comms.end()) {
+                auto const level = *comms.begin();
+                return callback(level.num_groups(), level.comm_orig);
+            }
+        }
+        auto const& comm = comms.comm_final();
+        return callback(comm.size(), comm);
+    }
+
     template <typename StringSet, typename ExtraArg, typename PermutationBuilder>
     void exchange_and_merge(
         StringLcpContainer<StringSet>& container,
@@ -216,6 +302,53 @@ public:
     void push(StringSet const& ss, std::vector<size_t>) {}
 };
 
+// Concatenate the given (sorted) containers into one, returning the size of each run.
+template <typename StringSet>
+std::vector<size_t> concat_sorted_runs(
+    StringLcpContainer<StringSet>& container, std::vector<StringLcpContainer<StringSet>>& runs
+) {
+    size_t num_strings = 0, num_chars = 0;
+    for (auto const& run: runs) {
+        num_strings += run.size();
+        num_chars += run.char_size();
+    }
+
+    std::vector<typename StringSet::Char> raw_strings;
+    std::vector<typename StringSet::String> strings;
+    std::vector<size_t> lcps, run_sizes;
+    raw_strings.reserve(num_chars);
+    strings.reserve(num_strings);
+    lcps.reserve(num_strings);
+
+    for (auto& run: runs) {
+        if (run.empty()) {
+            continue;
+        }
+
+        // strings are rebased onto the new character array
+        assert(run.is_consistent());
+        auto const offset = raw_strings.size();
+        auto const old_base = run.raw_strings().data();
+        raw_strings.insert(raw_strings.end(), run.raw_strings().begin(), run.raw_strings().end());
+        for (auto const& str: run.get_strings()) {
+            auto& new_str = strings.emplace_back(str);
+            new_str.string = raw_strings.data() + offset + (str.string - old_base);
+        }
+
+        lcps.insert(lcps.end(), run.lcps().begin(), run.lcps().end());
+        lcps[lcps.size() - run.size()] = 0;
+        run_sizes.push_back(run.size());
+        run.delete_all();
+    }
+
+    container = StringLcpContainer<StringSet>{
+        std::move(raw_strings),
+        std::move(strings),
+        std::move(lcps)
+    };
+    return run_sizes;
+}
+
 } // namespace _internal
 
 template <AlltoallStringsConfig config, typename RedistributionPolicy, typename PartitionPolicy>
@@ -224,24 +357,120 @@ class DistributedMergeSort
 public:
     using Base = BaseDistributedMergeSort<config, RedistributionPolicy, PartitionPolicy>;
 
-    using Base::Base;
+    // With `overlap_splitters`, the splitters of the first level are chosen from a sample of
+    // the unsorted strings while local sorting runs on a separate thread.
+    explicit DistributedMergeSort(
+        PartitionPolicy partition,
+        RedistributionPolicy redistribution,
+        local_sort::LocalSorter local_sorter = {},
+        bool const overlap_splitters = false
+    )
+        : Base{std::move(partition), std::move(redistribution), local_sorter},
+          overlap_splitters_{overlap_splitters} {}
 
     using Subcommunicators = RedistributionPolicy::Subcommunicators;
 
     template <typename StringSet>
     void sort(StringLcpContainer<StringSet>& container, Subcommunicators const& comms)
         requires(StringSet::has_length)
+    {
+        sort_(container, comms);
+    }
+
+    // Sort the strings and compute the dense rank (name) of every string in the output,
+    // using the LCP array of the final merge.
+    template <typename StringSet>
+    Names sort_named(StringLcpContainer<StringSet>& container, Subcommunicators const& comms)
+        requires(StringSet::has_length)
+    {
+        // equal strings may span PEs if the input was already sorted
+        bool const is_partitioned = sort_(container, comms);
+        bool const splits_ties = !is_partitioned || Base::partition_splits_ties();
+
+        this->measuring_tool_.start("compute_names");
+        auto const strptr = container.make_string_lcp_ptr();
+        auto names = compute_names(strptr, splits_ties, comms.comm_root());
+        this->measuring_tool_.stop("compute_names");
+
+        this->measuring_tool_.add(names.num_distinct, "num_distinct");
+        return names;
+    }
+
+    // Merge multiple sequences that are each sorted across all PEs. Local sorting is skipped
+    // and the existing LCP arrays are reused. The result is written to `container`.
+    template <typename StringSet>
+    void merge(
+        StringLcpContainer<StringSet>& container,
+        std::vector<StringLcpContainer<StringSet>> sequences,
+        Subcommunicators const& comms
+    )
+        requires(StringSet::has_length)
     {
         auto const& comm_root = comms.comm_root();
 
+        this->measuring_tool_.setPhase("local_merging");
+        this->measuring_tool_.start("local_merging", "merge_locally");
+        auto run_sizes = _internal::concat_sorted_runs(container, sequences);
+        merge::choose_merge<false>(container, run_sizes);
+        this->measuring_tool_.stop("local_merging", "merge_locally", comm_root);
+        this->measuring_tool_.add(container.char_size(), "chars_in_set");
+
+        if (comm_root.size() > 1) {
+            _internal::DummyPermutationBuilder builder;
+
+            this->measuring_tool_.start("avg_lcp");
+            auto const avg_lcp = compute_global_lcp_average(container.lcps(), comm_root);
+            this->measuring_tool_.stop("avg_lcp");
+
+            Base::sort(container, comms, 100 * (avg_lcp + 5), builder);
+        }
+    }
+
+private:
+    bool overlap_splitters_ = false;
+
+    // Returns false if the distributed phase was skipped, since the input was already sorted.
+    template <typename StringSet>
+    bool sort_(StringLcpContainer<StringSet>& container, Subcommunicators const& comms) {
+        auto const& comm_root = comms.comm_root();
+
         this->measuring_tool_.setPhase("local_sorting");
         this->measuring_tool_.add(container.char_size(), "chars_in_set");
 
+        bool is_locally_sorted = false;
+        std::vector<typename StringSet::Char> presampled;
         {
-            this->measuring_tool_.start("local_sorting", "sort_locally");
             auto const strptr = container.make_string_lcp_ptr();
-            tlx::sort_strings_detail::radixsort_CI3(strptr, 0, 0);
-            this->measuring_tool_.stop("local_sorting", "sort_locally", comm_root);
+            if (overlap_splitters_ && comm_root.size() > 1) {
+                // the sample is drawn before sorting starts to permute the strings,
+                // MPI is only ever called from this thread
+                this->measuring_tool_.start("local_sorting", "select_splitters");
+                auto sample = Base::presample(container.make_string_set(), comms);
+
+                this->measuring_tool_.start("local_sorting", "sort_locally");
+                auto local_sort = std::async(std::launch::async, [&] {
+                    return this->local_sorter_.sort(strptr);
+                });
+                presampled = Base::select_presampled(std::move(sample), comms);
+                this->measuring_tool_.stop("local_sorting", "select_splitters");
+
+                is_locally_sorted = local_sort.get();
+                this->measuring_tool_.stop("local_sorting", "sort_locally", comm_root);
+            } else {
+                this->measuring_tool_.start("local_sorting", "sort_locally");
+                is_locally_sorted = this->local_sorter_.sort(strptr);
+                this->measuring_tool_.stop("local_sorting", "sort_locally", comm_root);
+            }
+        }
+
+        if (comm_root.size() > 1 && this->local_sorter_.detect_presorted()) {
+            // skip the distributed phase entirely if the input is already globally sorted
+            this->measuring_tool_.start("check_global_order");
+            bool const is_sorted = is_globally_sorted(container, is_locally_sorted, comm_root);
+            this->measuring_tool_.stop("check_global_order");
+            if (is_sorted) {
+                return false;
+            }
         }
 
         if (comm_root.size() > 1) {
@@ -251,8 +480,9 @@ public:
             auto const avg_lcp = compute_global_lcp_average(container.lcps(), comm_root);
             this->measuring_tool_.stop("avg_lcp");
 
-            Base::sort(container, comms, 100 * (avg_lcp + 5), builder);
+            Base::sort(container, comms, 100 * (avg_lcp + 5), builder, std::move(presampled));
         }
+        return true;
     }
 };
 
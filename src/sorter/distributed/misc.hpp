@@ -10,6 +10,7 @@
 #include <iterator>
 #include <numeric>
 #include <random>
+#include <vector>
 
 #include <kamping/collectives/allgather.hpp>
 #include <kamping/collectives/allreduce.hpp>
@@ -21,6 +22,7 @@
 #include <tlx/sort/strings/radix_sort.hpp>
 
 #include "mpi/communicator.hpp"
+#include "mpi/rotate.hpp"
 #include "strings/stringcontainer.hpp"
 #include "strings/stringtools.hpp"
 
@@ -126,6 +128,93 @@ StringContainer<StringSet> choose_splitters_distributed(
     }
 }
 
+// Check whether the concatenation of all (locally sorted) sets is globally sorted, by comparing
+// the first string on each PE with the last string on its predecessor. Conservatively returns
+// false if any PE is empty.
+template <typename StringSet>
+bool is_globally_sorted(
+    StringLcpContainer<StringSet>& container, bool const is_locally_sorted, Communicator const& comm
+) {
+    auto const last_string = container.get_raw_string(std::ssize(container) - 1);
+    std::vector<typename StringSet::Char> pred_string;
+    mpi::rotate_strings_right(last_string, pred_string, false, comm);
+
+    bool is_sorted = is_locally_sorted && !container.empty();
+    if (is_sorted && !comm.is_root()) {
+        auto const first_string = container.get_raw_string(0);
+        is_sorted = dss_schimek::leq(pred_string.data(), first_string.data());
+    }
+    return comm.allreduce_single(
+        kamping::send_buf({is_sorted}),
+        kamping::op(kamping::ops::logical_and<>{})
+    );
+}
+
+// Dense ranks (names) of a globally sorted string set, equal strings receive the same name.
+struct Names {
+    std::vector<size_t> names;
+    size_t num_distinct;
+};
+
+// Compute the name of each string of a globally sorted set from its LCP array, where a string
+// is equal to its predecessor iff the LCP equals its length. The first string on each PE is
+// compared with the last string on its (non-empty) predecessor only if equal strings may be
+// split between PEs, otherwise an exclusive scan over the local number of names suffices.
+template <typename StringLcpPtr>
+Names compute_names(StringLcpPtr const& strptr, bool const splits_ties, Communicator const& comm) {
+    using Char = StringLcpPtr::StringSet::Char;
+
+    auto const& ss = strptr.active();
+    std::vector<size_t> names(ss.size());
+
+    bool starts_name = true;
+    if (splits_ties && comm.size() > 1) {
+        std::vector<Char> last_string, pred_string;
+        if (!ss.empty()) {
+            auto const& last = *(ss.end() - 1);
+            auto const chars = ss.get_chars(last, 0);
+            last_string.assign(chars, chars + ss.get_length(last));
+            last_string.push_back(0);
+        }
+
+        // empty PEs forward the string of their predecessor
+        bool const skip_rank = ss.empty() && !comm.is_root();
+        mpi::rotate_strings_right(last_string, pred_string, skip_rank, comm);
+
+        if (!ss.empty() && !comm.is_root() && !pred_string.empty()) {
+            auto const& first = *ss.begin();
+            auto const length = ss.get_length(first);
+            auto const chars = ss.get_chars(first, 0);
+            starts_name = pred_string.size() != length + 1
+                          || !std::equal(chars, chars + length, pred_string.begin());
+        }
+    }
+
+    size_t local_num_names = 0;
+    if (size_t i = 0; !ss.empty()) {
+        for (auto it = ss.begin(); it != ss.end(); ++i, ++it) {
+            bool const is_new = i == 0 ? starts_name : strptr.get_lcp(i) != ss.get_length(ss[it]);
+            local_num_names += is_new;
+            names[i] = local_num_names;
+        }
+    }
+
+    size_t const offset = comm.exscan_single(
+        kamping::send_buf(local_num_names),
+        kamping::op(kamping::ops::plus<>{})
+    );
+    size_t const num_distinct = comm.allreduce_single(
+        kamping::send_buf(local_num_names),
+        kamping::op(kamping::ops::plus<>{})
+    );
+
+    // names are zero-based
+    for (auto& name: names) {
+        name += offset - 1;
+    }
+    return {std::move(names), num_distinct};
+}
+
 inline size_t compute_global_lcp_average(std::span<size_t const> lcps, Communicator const& comm) {
     size_t const local_lcp_sum = std::accumulate(lcps.begin(), lcps.end(), size_t{0});
     auto result = comm.allreduce(
@@ -155,6 +244,23 @@ inline size_t binary_search(StringSet const& ss, typename StringSet::String cons
     return left - ss.begin();
 }
 
+// Returns the index of the first string that is greater than `value`. Unlike `binary_search`,
+// this ensures that equal strings are never split between intervals.
+template <typename StringSet>
+inline size_t binary_search_upper(StringSet const& ss, typename StringSet::String const& value) {
+    auto left = ss.begin(), right = ss.end();
+
+    while (left != right) {
+        size_t const dist = (right - left) / 2;
+        if (ss.scmp(ss[left + dist], value) <= 0) {
+            left = left + dist + 1;
+        } else {
+            right = left + dist;
+        }
+    }
+    return left - ss.begin();
+}
+
 template <typename StringSet>
 inline size_t binary_search_indexed(
     StringSet const& ss,
@@ -235,6 +341,28 @@ compute_interval_binary(StringSet const& ss, SplitterSet const& splitters)
     return intervals;
 }
 
+// Like `compute_interval_binary`, but all copies of a splitter are assigned to the interval
+// left of it, see `binary_search_upper`.
+template <typename StringSet, typename SplitterSet>
+inline std::vector<size_t>
+compute_interval_upper_bound(StringSet const& ss, SplitterSet const& splitters)
+    requires(StringSet::has_length)
+{
+    using String = StringSet::String;
+
+    std::vector<size_t> intervals;
+    intervals.reserve(splitters.size() + 1);
+
+    for (auto const& splitter: splitters) {
+        String const splitter_{splitter.string, splitter.length};
+        intervals.emplace_back(binary_search_upper(ss, splitter_));
+    }
+    intervals.emplace_back(ss.size());
+
+    std::adjacent_difference(intervals.begin(), intervals.end(), intervals.begin());
+    return intervals;
+}
+
 template <typename StringSet, typename SplitterSet>
 inline std::vector<size_t> compute_interval_binary_index(
     StringSet const& ss, SplitterSet const& splitters, uint64_t const local_offset
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <array>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <utility>
@@ -230,20 +231,21 @@ private:
 };
 
 
+// The communicators are referenced instead of copied, hence the given split must outlive this.
 template <typename Communicator>
 struct GridCommunicators {
-    std::vector<Communicator> comms;
+    std::vector<std::reference_wrapper<Communicator const>> comms;
 
     explicit GridCommunicators(NoSplit<Communicator> const& no_split)
-        : comms{no_split.comm_final()} {}
+        : comms{std::cref(no_split.comm_final())} {}
 
     explicit GridCommunicators(RowwiseSplit<Communicator> const& naive_split)
-        : comms{naive_split.comms_row().comms} {
+        : comms(naive_split.comms_row().comms.begin(), naive_split.comms_row().comms.end()) {
         comms.emplace_back(naive_split.comm_final());
     }
 
     explicit GridCommunicators(GridwiseSplit<Communicator> const& grid_split)
-        : comms{grid_split.comms_col().comms} {
+        : comms(grid_split.comms_col().comms.begin(), grid_split.comms_col().comms.end()) {
         comms.emplace_back(grid_split.comm_final());
     }
 };
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <numeric>
 #include <random>
 #include <type_traits>
@@ -13,6 +14,11 @@
 #include <vector>
 
 #include <kamping/collectives/allgather.hpp>
+#include <kamping/collectives/allreduce.hpp>
+#include <kamping/collectives/exscan.hpp>
+#include <kamping/mpi_ops.hpp>
+#include <kamping/named_parameters.hpp>
+#include <tlx/die.hpp>
 
 #include "mpi/communicator.hpp"
 #include "sorter/RQuick/RQuick.hpp"
@@ -37,6 +43,16 @@ public:
 
     explicit PartitionPolicy(size_t const sampling_factor) : SamplePolicy{sampling_factor} {}
 
+    explicit PartitionPolicy(sample::SamplingConfig const config, bool const keep_ties = false)
+        : SamplePolicy{config},
+          keep_ties_{keep_ties} {}
+
+    // Whether equal strings may be assigned to different partitions. If `keep_ties` is set
+    // (and sampling is not indexed), all copies of a string are assigned to the same partition.
+    // This may unbalance partitions with many duplicates, and is therefore only enabled when
+    // required, e.g. for computing names.
+    bool splits_ties() const { return SamplePolicy::is_indexed || !keep_ties_; }
+
     template <typename StringPtr, typename SamplerArg>
     std::vector<size_t> compute_partition(
         StringPtr const& strptr,
@@ -56,7 +72,7 @@ public:
         measuring_tool.stop("sample_strings");
 
         auto chosen_splitters =
-            SplitterPolicy::select_splitters(strptr, std::move(sample), num_partitions, comm);
+            SplitterPolicy::select_splitters(std::move(sample), num_partitions, comm);
 
         measuring_tool.start("compute_intervals");
         auto splitter_set = chosen_splitters.make_string_set();
@@ -64,6 +80,8 @@ public:
         if constexpr (SamplePolicy::is_indexed) {
             interval_sizes =
                 compute_interval_binary_index(strptr.active(), splitter_set, sample.local_offset);
+        } else if (keep_ties_) {
+            interval_sizes = compute_interval_upper_bound(strptr.active(), splitter_set);
         } else {
             interval_sizes = compute_interval_binary(strptr.active(), splitter_set);
         }
@@ -75,6 +93,297 @@ public:
 
         return interval_sizes;
     }
+
+    // Draw the sample for `num_partitions` partitions from the unsorted local strings, such that
+    // splitter selection (using `select_presampled`) can overlap with local sorting.
+    template <typename StringSet, typename SamplerArg>
+    std::vector<typename StringSet::Char> presample(
+        StringSet const& ss,
+        size_t const num_partitions,
+        SamplerArg const arg,
+        Communicator const& comm
+    ) const {
+        if constexpr (SamplePolicy::is_indexed) {
+            tlx_die("indexed sampling requires locally sorted strings");
+        } else {
+            auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+            measuring_tool.start("sample_strings");
+            auto sample = SamplePolicy::sample_splitters(ss, num_partitions, arg, comm);
+            measuring_tool.stop("sample_strings");
+            return std::move(sample.sample);
+        }
+    }
+
+    // Returns the characters of the splitters chosen from a sample drawn by `presample`.
+    template <typename Char>
+    std::vector<Char> select_presampled(
+        std::vector<Char>&& sample, size_t const num_partitions, Communicator const& comm
+    ) const {
+        if constexpr (SamplePolicy::is_indexed) {
+            tlx_die("indexed sampling requires locally sorted strings");
+        } else {
+            sample::SampleResult<Char, false> sample_{std::move(sample)};
+            auto chosen_splitters =
+                SplitterPolicy::select_splitters(std::move(sample_), num_partitions, comm);
+            return std::move(chosen_splitters.release_raw_strings());
+        }
+    }
+
+private:
+    bool keep_ties_ = false;
+};
+
+// Computes exactly balanced partitions by distributed multi-sequence selection on the locally
+// sorted strings, instead of choosing splitters from a sample. In each round, every unresolved
+// splitter draws a uniformly random pivot from the strings that may still contain its split
+// position and narrows this range on all PEs, which takes O(log n) rounds in expectation.
+// Partitions are balanced by number of strings, or by number of characters (up to the weight
+// of a single string) if `char_based` is set. Equal strings may be split between partitions.
+template <bool char_based>
+class ExactPartitionPolicy {
+public:
+    bool splits_ties() const { return true; }
+
+    template <typename StringPtr, typename SamplerArg>
+    std::vector<size_t> compute_partition(
+        StringPtr const& strptr,
+        size_t const num_partitions,
+        SamplerArg const arg,
+        Communicator const& comm
+    ) const {
+        assert(num_partitions > 0 || strptr.size() == 0);
+        if (num_partitions <= 1) {
+            return {strptr.size()};
+        }
+
+        auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+        auto const& ss = strptr.active();
+
+        measuring_tool.start("compute_weights");
+        // weights[i] is the accumulated weight of the first i local strings
+        std::vector<size_t> weights(ss.size() + 1, 0);
+        for (size_t i = 0; i != ss.size(); ++i) {
+            weights[i + 1] = weights[i] + get_weight(ss, ss.at(i), i, arg);
+        }
+        size_t const total_weight = comm.allreduce_single(
+            kamping::send_buf(weights.back()),
+            kamping::op(kamping::ops::plus<>{})
+        );
+        measuring_tool.stop("compute_weights");
+
+        measuring_tool.start("select_splitters");
+        State state{num_partitions - 1, ss.size()};
+        for (size_t j = 0; j != state.targets.size(); ++j) {
+            state.targets[j] = target_weight(j + 1, total_weight, num_partitions);
+        }
+
+        // all PEs draw the same sequence of pivot positions
+        std::mt19937_64 gen;
+        size_t num_rounds = 0;
+        for (; !state.unresolved.empty(); ++num_rounds) {
+            selection_round(ss, weights, state, gen, comm);
+        }
+        measuring_tool.stop("select_splitters");
+        measuring_tool.add(num_rounds, "exact_partition_rounds");
+
+        auto& interval_sizes = state.splits;
+        interval_sizes.push_back(ss.size());
+        std::adjacent_difference(
+            interval_sizes.begin(),
+            interval_sizes.end(),
+            interval_sizes.begin()
+        );
+        return interval_sizes;
+    }
+
+    template <typename StringSet, typename SamplerArg>
+    std::vector<typename StringSet::Char>
+    presample(StringSet const&, size_t, SamplerArg, Communicator const&) const {
+        tlx_die("exact splitting requires locally sorted strings");
+    }
+
+    template <typename Char>
+    std::vector<Char> select_presampled(std::vector<Char>&&, size_t, Communicator const&) const {
+        tlx_die("exact splitting requires locally sorted strings");
+    }
+
+private:
+    struct State {
+        // the local split position of splitter j is contained in [lower[j], upper[j]]
+        std::vector<size_t> lower, upper;
+        std::vector<size_t> targets;
+        std::vector<size_t> splits;
+        std::vector<size_t> unresolved;
+
+        State(size_t const num_splitters, size_t const num_strings)
+            : lower(num_splitters, 0),
+              upper(num_splitters, num_strings),
+              targets(num_splitters),
+              splits(num_splitters),
+              unresolved(num_splitters) {
+            std::iota(unresolved.begin(), unresolved.end(), size_t{0});
+        }
+    };
+
+    // Returns floor(j * total / num_partitions), computed without overflowing.
+    static size_t
+    target_weight(size_t const j, size_t const total, size_t const num_partitions) {
+        return j * (total / num_partitions) + (j * (total % num_partitions)) / num_partitions;
+    }
+
+    template <typename StringSet, typename SamplerArg>
+    static size_t get_weight(
+        StringSet const& ss,
+        typename StringSet::String const& str,
+        size_t const index,
+        SamplerArg const arg
+    ) {
+        if constexpr (char_based) {
+            return sample::get_string_len(ss, str, index, arg) + 1;
+        } else {
+            return 1;
+        }
+    }
+
+    // Returns the first index in [begin, end) for which `pred` does not hold.
+    template <typename StringSet, typename Predicate>
+    static size_t
+    partition_point(StringSet const& ss, size_t begin, size_t end, Predicate&& pred) {
+        while (begin != end) {
+            size_t const mid = begin + (end - begin) / 2;
+            if (pred(ss.at(mid))) {
+                begin = mid + 1;
+            } else {
+                end = mid;
+            }
+        }
+        return begin;
+    }
+
+    template <typename StringSet>
+    static void selection_round(
+        StringSet const& ss,
+        std::vector<size_t> const& weights,
+        State& state,
+        std::mt19937_64& gen,
+        Communicator const& comm
+    ) {
+        using Char = StringSet::Char;
+        using String = StringSet::String;
+        using PivotSet = dss_schimek::StringSet<Char, dss_schimek::Length>;
+
+        auto const num_unresolved = state.unresolved.size();
+
+        std::vector<size_t> local_sizes(num_unresolved);
+        for (size_t k = 0; k != num_unresolved; ++k) {
+            auto const j = state.unresolved[k];
+            local_sizes[k] = state.upper[j] - state.lower[j];
+        }
+
+        std::vector<size_t> local_offsets;
+        comm.exscan(
+            kamping::send_buf(local_sizes),
+            kamping::recv_buf(local_offsets),
+            kamping::op(std::plus<>{})
+        );
+        auto size_result =
+            comm.allreduce(kamping::send_buf(local_sizes), kamping::op(std::plus<>{}));
+        auto const global_sizes = size_result.extract_recv_buffer();
+
+        // the PE holding the randomly drawn position contributes the pivot
+        std::vector<Char> local_pivots;
+        std::vector<size_t> local_pivot_ids;
+        for (size_t k = 0; k != num_unresolved; ++k) {
+            if (global_sizes[k] == 0) {
+                continue;
+            }
+
+            std::uniform_int_distribution<size_t> dist{0, global_sizes[k] - 1};
+            auto const pos = dist(gen);
+            if (local_offsets[k] <= pos && pos < local_offsets[k] + local_sizes[k]) {
+                auto const j = state.unresolved[k];
+                auto const& pivot = ss.at(state.lower[j] + (pos - local_offsets[k]));
+                auto const pivot_chars = ss.get_chars(pivot, 0);
+                local_pivots.insert(
+                    local_pivots.end(),
+                    pivot_chars,
+                    pivot_chars + ss.get_length(pivot)
+                );
+                local_pivots.push_back(0);
+                local_pivot_ids.push_back(k);
+            }
+        }
+
+        auto pivot_result = comm.allgatherv(kamping::send_buf(local_pivots));
+        StringContainer<PivotSet> const pivots{pivot_result.extract_recv_buffer()};
+        auto id_result = comm.allgatherv(kamping::send_buf(local_pivot_ids));
+        auto const pivot_ids = id_result.extract_recv_buffer();
+        assert_equal(pivots.size(), pivot_ids.size());
+
+        // compute the range of strings equal to each pivot
+        auto const pivot_set = pivots.make_string_set();
+        auto const num_pivots = pivot_ids.size();
+        std::vector<size_t> equal_begin(num_pivots), equal_end(num_pivots);
+        std::vector<size_t> local_counts(2 * num_pivots), local_equal(num_pivots);
+        for (size_t p = 0; auto const& pivot_str: pivot_set) {
+            String const pivot{pivot_str.string, pivot_str.length};
+            auto const j = state.unresolved[pivot_ids[p]];
+
+            auto const is_less = [&](auto const& str) { return ss.scmp(str, pivot) < 0; };
+            auto const is_leq = [&](auto const& str) { return ss.scmp(str, pivot) <= 0; };
+            equal_begin[p] = partition_point(ss, state.lower[j], state.upper[j], is_less);
+            equal_end[p] = partition_point(ss, equal_begin[p], state.upper[j], is_leq);
+
+            local_counts[2 * p] = weights[equal_begin[p]];
+            local_counts[2 * p + 1] = weights[equal_end[p]];
+            local_equal[p] = weights[equal_end[p]] - weights[equal_begin[p]];
+            ++p;
+        }
+
+        auto count_result =
+            comm.allreduce(kamping::send_buf(local_counts), kamping::op(std::plus<>{}));
+        auto const global_counts = count_result.extract_recv_buffer();
+        std::vector<size_t> equal_offsets;
+        comm.exscan(
+            kamping::send_buf(local_equal),
+            kamping::recv_buf(equal_offsets),
+            kamping::op(std::plus<>{})
+        );
+
+        // splitters without any remaining strings are resolved at their lower bound
+        for (size_t k = 0; k != num_unresolved; ++k) {
+            if (global_sizes[k] == 0) {
+                auto const j = state.unresolved[k];
+                state.splits[j] = state.lower[j];
+                state.unresolved[k] = state.targets.size();
+            }
+        }
+
+        for (size_t p = 0; p != num_pivots; ++p) {
+            auto const k = pivot_ids[p];
+            auto const j = state.unresolved[k];
+            auto const target = state.targets[j];
+            auto const less = global_counts[2 * p], leq = global_counts[2 * p + 1];
+
+            if (target < less) {
+                state.upper[j] = equal_begin[p];
+            } else if (target > leq) {
+                state.lower[j] = equal_end[p];
+            } else {
+                // strings equal to the pivot are assigned in rank order
+                auto const remaining = target - less;
+                auto const local_remaining =
+                    remaining - std::min(remaining, equal_offsets[p]);
+                auto const first = weights.begin() + equal_begin[p];
+                auto const last = weights.begin() + equal_end[p] + 1;
+                auto const it = std::upper_bound(first, last, *first + local_remaining);
+                state.splits[j] = (it - weights.begin()) - 1;
+                state.unresolved[k] = state.targets.size();
+            }
+        }
+
+        std::erase(state.unresolved, state.targets.size());
+    }
 };
 
 template <typename Char, bool is_indexed, typename Derived>
@@ -82,9 +391,7 @@ class BaseSplitterPolicy {
 public:
     using Sample = sample::SampleResult<Char, is_indexed>;
 
-    template <typename StringPtr>
     static auto select_splitters(
-        StringPtr const& strptr,
         Sample&& sample,
         size_t const num_partitions,
         Communicator const& comm
@@ -5,17 +5,23 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <numeric>
 #include <ostream>
+#include <span>
 #include <type_traits>
 #include <vector>
 
+#include <kamping/collectives/allreduce.hpp>
 #include <kamping/collectives/alltoall.hpp>
 #include <kamping/collectives/exscan.hpp>
 #include <kamping/named_parameters.hpp>
 #include <tlx/die.hpp>
 
+#include "encoding/integer_compression.hpp"
+#include "mpi/alltoall_combined.hpp"
+#include "mpi/sparse_alltoall.hpp"
 #include "strings/stringset.hpp"
 
 namespace dss_mehnert {
@@ -48,6 +54,90 @@ void write_member(StringSet const& ss, Member const member, OutputIterator const
     std::transform(ss.begin(), ss.end(), d_first, [=](auto const& str) { return member(str); });
 }
 
+inline size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    for (; value >= 128; value >>= 7) {
+        ++size;
+    }
+    return size;
+}
+
+// Global indices sent back to a PE are increasing, because they are assigned in sorted order.
+// Hence, each message is encoded as varints: the number of values, `num_raw` values that are
+// sent as is, followed by the differences between consecutive remaining values. The size of
+// each message is computed in a first pass, such that no buffer is overallocated.
+inline std::vector<uint8_t> encode_indices(
+    std::vector<size_t> const& values,
+    std::vector<size_t> const& counts,
+    size_t const num_raw,
+    std::vector<size_t>& byte_counts
+) {
+    auto for_each_encoded = [&](auto&& callback) {
+        auto input_it = values.begin();
+        for (size_t rank = 0; rank != counts.size(); ++rank) {
+            if (counts[rank] > 0) {
+                callback(rank, counts[rank]);
+            }
+            for (size_t i = 0, prev = 0; i != counts[rank]; ++i, ++input_it) {
+                callback(rank, i < num_raw ? *input_it : *input_it - prev);
+                prev = i < num_raw ? 0 : *input_it;
+            }
+        }
+    };
+
+    byte_counts.assign(counts.size(), 0);
+    for_each_encoded([&](size_t const rank, size_t const value) {
+        byte_counts[rank] += varint_size(value);
+    });
+
+    std::vector<uint8_t> bytes(std::accumulate(byte_counts.begin(), byte_counts.end(), size_t{0}));
+    dss_schimek::Writer writer{bytes.data()};
+    for_each_encoded([&](size_t, size_t const value) { writer.PutVarint(value); });
+    assert_equal(writer.getNumPutBytes(), bytes.size());
+    return bytes;
+}
+
+inline std::vector<size_t> decode_indices(std::vector<uint8_t> const& bytes, size_t const num_raw) {
+    std::vector<size_t> values;
+    for (auto it = bytes.data(), end = bytes.data() + bytes.size(); it != end;) {
+        size_t count = 0;
+        dss_schimek::Reader count_reader{it, &count, &count + 1};
+        count_reader.decode();
+        it += count_reader.getNumReadBytes();
+
+        size_t const offset = values.size();
+        values.resize(offset + count);
+        dss_schimek::Reader reader{it, values.begin() + offset, values.end()};
+        reader.decode();
+        it += reader.getNumReadBytes();
+
+        auto const deltas_begin = values.begin() + offset + std::min(count, num_raw);
+        std::inclusive_scan(deltas_begin, values.end(), deltas_begin);
+    }
+    return values;
+}
+
+// Send the (increasing) global indices of a reverse permutation exchange, either as raw 64-bit
+// values or in compressed form. Counts may exceed the range of int.
+template <typename Communicator>
+std::vector<size_t> alltoallv_indices(
+    std::vector<size_t> const& send_buf,
+    std::vector<size_t> const& send_counts,
+    size_t const num_raw,
+    bool const compress,
+    Communicator const& comm
+) {
+    constexpr auto kind = mpi::AlltoallvCombinedKind::combined;
+    if (!compress) {
+        return comm.template alltoallv_combined<kind>(send_buf, send_counts);
+    }
+
+    std::vector<size_t> byte_counts;
+    auto const bytes = encode_indices(send_buf, send_counts, num_raw, byte_counts);
+    auto const recv_bytes = comm.template alltoallv_combined<kind>(bytes, byte_counts);
+    return decode_indices(recv_bytes, num_raw);
+}
+
 } // namespace _internal
 
 class NoPermutation {};
@@ -94,23 +184,33 @@ public:
         Subcommunicators const& comms
     ) const {
         namespace kmp = kamping;
+        using Entry = std::array<index_type, 2>;
 
         auto const& comm = comms.comm_root();
-        std::vector<int> counts(comm.size()), offsets(comm.size());
-        std::for_each(ranks_.begin(), ranks_.end(), [&](auto const rank) { ++counts[rank]; });
-        std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), 0);
-
         index_type const local_index_offset =
             comm.exscan_single(kmp::send_buf(size()), kmp::op(std::plus<>{}));
         index_type const index_offset = global_index_offset + local_index_offset;
 
-        std::vector<std::array<index_type, 2>> send_buf(size()), recv_buf;
+        // group entries by origin PE, without allocating a counter for every PE
+        std::vector<size_type> order(size());
+        std::iota(order.begin(), order.end(), size_type{0});
+        std::sort(order.begin(), order.end(), [&](auto const lhs, auto const rhs) {
+            return ranks_[lhs] < ranks_[rhs];
+        });
+
+        std::vector<Entry> send_buf(size());
+        std::vector<mpi::MessageCount> counts;
         for (size_type i = 0; i != size(); ++i) {
-            send_buf[offsets[ranks_[i]]++] = {strings_[i], index_offset + i};
+            auto const j = order[i];
+            auto const rank = static_cast<int>(ranks_[j]);
+            send_buf[i] = {strings_[j], index_offset + j};
+            if (counts.empty() || counts.back().rank != rank) {
+                counts.push_back({rank, 0});
+            }
+            ++counts.back().count;
         }
 
-        comm.alltoallv(kmp::send_buf(send_buf), kmp::send_counts(counts), kmp::recv_buf(recv_buf));
-
+        auto const recv_buf = mpi::sparse_alltoallv<Entry>(send_buf, counts, comm);
         for (auto const& [local_index, global_index]: recv_buf) {
             global_permutation[local_index] = global_index;
         }
@@ -185,7 +285,8 @@ public:
     void apply(
         std::span<index_type> global_permutation,
         index_type const global_index_offset,
-        Subcommunicators const& comms
+        Subcommunicators const& comms,
+        bool const compress_indices = false
     ) const {
         assert(comms.comm_root().is_same_on_all_ranks(global_index_offset));
 
@@ -200,14 +301,184 @@ public:
                 dest[offsets[ranks[i]]++] = index_offset + i;
             }
         };
-        apply_(global_permutation, compute_indices, comms);
+        apply_(global_permutation, compute_indices, compress_indices, comms);
+    }
+
+    // Apply the permutations of several consecutive quantiles, using a single reverse exchange
+    // per level. Returns the global index offset following the last quantile of the batch.
+    template <typename Subcommunicators>
+    static index_type apply_batch(
+        std::span<MultiLevelPermutation const> batch,
+        std::span<index_type> global_permutation,
+        index_type global_index_offset,
+        Subcommunicators const& comms,
+        bool const compress_indices = false
+    ) {
+        std::vector<MultiLevelPermutation const*> permutations;
+        std::vector<index_type> local_sizes;
+        for (auto const& permutation: batch) {
+            permutations.push_back(&permutation);
+            local_sizes.push_back(permutation.num_sorted());
+        }
+
+        auto const index_offsets =
+            compute_batch_offsets(local_sizes, global_index_offset, comms.comm_root());
+        auto compute_indices = [&](size_type const k, auto const& ranks, auto& offsets, auto& dest) {
+            for (size_type i = 0; i != ranks.size(); ++i) {
+                dest[offsets[ranks[i]]++] = index_offsets[k] + i;
+            }
+        };
+        apply_batch_(permutations, global_permutation, compute_indices, compress_indices, comms);
+        return global_index_offset;
     }
 
 protected:
+    // number of strings that ended up on this PE after sorting
+    size_type num_sorted() const {
+        return remote_permutations_.empty() ? local_permutation_.size()
+                                            : remote_permutations_.back().ranks.size();
+    }
+
+    // Compute the first global index used by each quantile of a batch, given the number of
+    // global indices used locally by each quantile. Advances `global_index_offset`.
+    template <typename Communicator>
+    static std::vector<index_type> compute_batch_offsets(
+        std::vector<index_type> const& local_sizes,
+        index_type& global_index_offset,
+        Communicator const& comm
+    ) {
+        std::vector<index_type> local_offsets;
+        comm.exscan(
+            kamping::send_buf(local_sizes),
+            kamping::recv_buf(local_offsets),
+            kamping::op(std::plus<>{})
+        );
+        auto result = comm.allreduce(kamping::send_buf(local_sizes), kamping::op(std::plus<>{}));
+        auto const global_sizes = result.extract_recv_buffer();
+
+        std::vector<index_type> index_offsets(local_sizes.size());
+        for (size_type k = 0; k != local_sizes.size(); ++k) {
+            index_offsets[k] = global_index_offset + local_offsets[k];
+            global_index_offset += global_sizes[k];
+        }
+        return index_offsets;
+    }
+
+    // Every message of the batched exchange starts with the number of values sent for each
+    // permutation, followed by the values of each permutation in order. Since the quantiles
+    // are consecutive, the values following the counts are still increasing. PEs that receive
+    // no values are sent no counts either, hence the received messages can be split without
+    // knowing their sources.
+    template <typename Subcommunicators, typename ComputeIndices>
+    static void apply_batch_(
+        std::span<MultiLevelPermutation const* const> batch,
+        std::span<index_type> global_permutation,
+        ComputeIndices compute_indices,
+        bool const compress_indices,
+        Subcommunicators const& comms
+    ) {
+        if (batch.empty()) {
+            return;
+        } else if (comms.comm_root().size() == 1) {
+            // a single PE does not communicate, hence the indices need not be computed
+            auto const no_indices = [](auto&&...) {};
+            for (auto const permutation: batch) {
+                permutation->apply_(global_permutation, no_indices, false, comms);
+            }
+            return;
+        }
+
+        size_type const num_batched = batch.size();
+        size_type const depth = batch.front()->depth();
+        assert_equal(
+            std::distance(comms.begin(), comms.end()) + 1,
+            std::ssize(batch.front()->remote_permutations_)
+        );
+
+        std::vector<std::vector<index_type>> values(num_batched);
+        std::vector<index_type> send_buf, recv_buf;
+        std::vector<size_t> send_counts, send_offsets, offsets;
+
+        auto level_it = comms.rbegin();
+        for (size_type level = depth; level-- > 0;) {
+            bool const is_first = level + 1 == depth;
+            auto const& comm = is_first ? comms.comm_final() : (*level_it++).comm_exchange;
+
+            send_counts.assign(comm.size(), 0);
+            for (auto const permutation: batch) {
+                auto const& counts = permutation->remote(level).counts;
+                assert_equal(counts.size(), comm.size());
+                for (size_type rank = 0; rank != comm.size(); ++rank) {
+                    send_counts[rank] += counts[rank];
+                }
+            }
+            for (auto& count: send_counts) {
+                count += count > 0 ? num_batched : 0;
+            }
+            send_offsets.resize(comm.size());
+            std::exclusive_scan(
+                send_counts.begin(),
+                send_counts.end(),
+                send_offsets.begin(),
+                size_t{0}
+            );
+            send_buf.resize(send_offsets.back() + send_counts.back());
+
+            offsets = send_offsets;
+            for (size_type rank = 0; rank != comm.size(); ++rank) {
+                if (send_counts[rank] > 0) {
+                    for (auto const permutation: batch) {
+                        send_buf[offsets[rank]++] = permutation->remote(level).counts[rank];
+                    }
+                }
+            }
+            for (size_type k = 0; k != num_batched; ++k) {
+                auto const& ranks = batch[k]->remote(level).ranks;
+                if (is_first) {
+                    compute_indices(k, ranks, offsets, send_buf);
+                } else {
+                    assert_equal(values[k].size(), ranks.size());
+                    for (size_type i = 0; i != ranks.size(); ++i) {
+                        send_buf[offsets[ranks[i]]++] = values[k][i];
+                    }
+                }
+            }
+
+            // the per-permutation counts at the start of each message are not increasing
+            recv_buf = _internal::alltoallv_indices(
+                send_buf,
+                send_counts,
+                num_batched,
+                compress_indices,
+                comm
+            );
+
+            // split the received values by permutation, keeping the order of source ranks
+            std::for_each(values.begin(), values.end(), [](auto& v) { v.clear(); });
+            for (auto it = recv_buf.begin(); it != recv_buf.end();) {
+                auto const header = it;
+                it += num_batched;
+                for (size_type k = 0; k != num_batched; ++k) {
+                    values[k].insert(values[k].end(), it, it + header[k]);
+                    it += header[k];
+                }
+            }
+        }
+
+        for (size_type k = 0; k != num_batched; ++k) {
+            auto const& local_permutation = batch[k]->local_permutation_;
+            assert_equal(local_permutation.size(), values[k].size());
+            for (size_type i = 0; auto const global_index: values[k]) {
+                global_permutation[local_permutation[i++]] = global_index;
+            }
+        }
+    }
+
     template <typename Subcommunicators, typename ComputeIndices>
     void apply_(
         std::span<index_type> global_permutation,
         ComputeIndices compute_indices,
+        bool const compress_indices,
         Subcommunicators const& comms
     ) const {
         if (comms.comm_root().size() == 1) {
@@ -248,12 +519,9 @@ protected:
             }
 
             auto const& comm = is_first ? comms.comm_final() : (*level_it++).comm_exchange;
-            comm.alltoallv(
-                kamping::send_buf(send_buf),
-                kamping::send_counts(counts),
-                kamping::send_displs(offsets),
-                kamping::recv_buf(recv_buf)
-            );
+            std::vector<size_t> const send_counts{counts.begin(), counts.end()};
+            recv_buf =
+                _internal::alltoallv_indices(send_buf, send_counts, 0, compress_indices, comm);
         }
 
         for (size_type i = 0; auto const global_index: recv_buf) {
@@ -300,7 +568,8 @@ public:
     void apply(
         std::span<index_type> global_permutation,
         index_type const global_index_offset,
-        Subcommunicators const& comms
+        Subcommunicators const& comms,
+        bool const compress_indices = false
     ) const {
         assert(comms.comm_root().is_same_on_all_ranks(global_index_offset));
 
@@ -319,7 +588,44 @@ public:
                 dest[offsets[ranks[i]]++] = current_index;
             }
         };
-        MultiLevelPermutation::apply_(global_permutation, compute_indices, comms);
+        MultiLevelPermutation::apply_(global_permutation, compute_indices, compress_indices, comms);
+    }
+
+    // See `MultiLevelPermutation::apply_batch`.
+    template <typename Subcommunicators>
+    static index_type apply_batch(
+        std::span<NonUniquePermutation const> batch,
+        std::span<index_type> global_permutation,
+        index_type global_index_offset,
+        Subcommunicators const& comms,
+        bool const compress_indices = false
+    ) {
+        std::vector<MultiLevelPermutation const*> permutations;
+        std::vector<index_type> local_sizes;
+        for (auto const& permutation: batch) {
+            auto const& offsets = permutation.index_offsets_;
+            permutations.push_back(&permutation);
+            local_sizes.push_back(std::accumulate(offsets.begin(), offsets.end(), index_type{0}));
+        }
+
+        auto const index_offsets =
+            compute_batch_offsets(local_sizes, global_index_offset, comms.comm_root());
+        auto compute_indices = [&](size_type const k, auto const& ranks, auto& offsets, auto& dest) {
+            auto const& index_offsets_k = batch[k].index_offsets_;
+            index_type current_index = index_offsets[k];
+            for (size_type i = 0; i != ranks.size(); ++i) {
+                current_index += index_offsets_k[i];
+                dest[offsets[ranks[i]]++] = current_index;
+            }
+        };
+        MultiLevelPermutation::apply_batch_(
+            permutations,
+            global_permutation,
+            compute_indices,
+            compress_indices,
+            comms
+        );
+        return global_index_offset;
     }
 
 private:
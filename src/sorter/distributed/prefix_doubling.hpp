@@ -8,13 +8,14 @@
 #include <iterator>
 #include <numeric>
 #include <random>
+#include <span>
 #include <type_traits>
+#include <vector>
 
 #include <kamping/collectives/allreduce.hpp>
 #include <kamping/collectives/alltoall.hpp>
 #include <kamping/named_parameters.hpp>
 #include <tlx/die.hpp>
-#include <tlx/sort/strings/radix_sort.hpp>
 #include <tlx/sort/strings/string_ptr.hpp>
 
 #include "mpi/communicator.hpp"
@@ -67,18 +68,35 @@ class BasePrefixDoublingMergeSort
     : protected BaseDistributedMergeSort<config, RedistributionPolicy, PartitionPolicy> {
 public:
     using Base = BaseDistributedMergeSort<config, RedistributionPolicy, PartitionPolicy>;
-    using Base::BaseDistributedMergeSort;
 
     using Subcommunicators = RedistributionPolicy::Subcommunicators;
 
+    // If at most `max_tail_candidates` strings are still undecided after a round of the bloom
+    // filter, these strings are sent with their full length instead of further doubling.
+    explicit BasePrefixDoublingMergeSort(
+        PartitionPolicy partition,
+        RedistributionPolicy redistribution,
+        local_sort::LocalSorter local_sorter = {},
+        size_t const max_tail_candidates = 0
+    )
+        : Base{std::move(partition), std::move(redistribution), local_sorter},
+          max_tail_candidates_{max_tail_candidates} {}
+
 protected:
+    size_t max_tail_candidates_;
+
     template <typename StringPtr>
     std::vector<size_t> run_bloom_filter(
         StringPtr const& strptr, Subcommunicators const& comms, size_t const start_depth
     ) {
         this->measuring_tool_.start("bloomfilter", "bloomfilter_overall");
         BloomFilter filter{comms, strptr.size()};
-        auto const prefixes = filter.compute_distinguishing_prefixes(strptr, comms, start_depth);
+        auto const prefixes = filter.compute_distinguishing_prefixes(
+            strptr,
+            comms,
+            start_depth,
+            max_tail_candidates_
+        );
         this->measuring_tool_.stop("bloomfilter", "bloomfilter_overall", comms.comm_root());
 
         auto const total_prefix = std::accumulate(prefixes.begin(), prefixes.end(), size_t{0});
@@ -96,62 +114,37 @@ protected:
     ) {
         auto const& comm_root = comms.comm_root();
 
-        if (comms.begin() == comms.end()) {
-            // special case for single-level sort; consider distinguishing prefixes
-            this->measuring_tool_.start("sort_globally", "final_sorting");
-            sample::DistPrefixes const arg{dist_prefixes};
-            auto const& comm = comms.comm_final();
+        // Only distinguishing prefixes are sent in the first exchange, such that the length
+        // of each received string is its distinguishing prefix. All later levels therefore
+        // sample and redistribute based on distinguishing prefixes without an explicit array.
+        bool is_first_exchange = true;
+        auto sort_level = [&](auto const& level, auto const& comm) {
             auto const strptr = container.make_string_lcp_ptr();
-            auto const send_counts = Base::compute_sorted_send_counts(strptr, arg, comm);
-            Base::exchange_and_merge(container, send_counts, arg, builder, comm);
-            this->measuring_tool_.stop("sort_globally", "final_sorting", comm_root);
-            this->measuring_tool_.setRound(0);
-            return;
-        }
-
-        if constexpr (!Subcommunicators::is_single_level) {
-            size_t round = 0;
-            auto level_it = comms.begin();
-            {
-                // first level of multi-level sort; consider distinguishing prefixes
-                this->measuring_tool_.start("sort_globally", "partial_sorting");
+            if (is_first_exchange) {
+                is_first_exchange = false;
                 sample::DistPrefixes const arg{dist_prefixes};
-                auto const level = *level_it++;
-                auto const& comm = level.comm_exchange;
-                auto const strptr = container.make_string_lcp_ptr();
                 auto const send_counts = Base::compute_sorted_send_counts(strptr, arg, level);
                 Base::exchange_and_merge(container, send_counts, arg, builder, comm);
-                this->measuring_tool_.stop("sort_globally", "partial_sorting", comm_root);
-                this->measuring_tool_.setRound(++round);
-            }
-
-            for (; level_it != comms.end(); ++level_it) {
-                // intermediate level of multi-level sort; don't consider distinguishing prefixes
-                this->measuring_tool_.start("sort_globally", "partial_sorting");
+            } else {
                 sample::NoExtraArg const arg;
-                auto const level = *level_it;
-                auto const& comm = level.comm_exchange;
-                auto const strptr = container.make_string_lcp_ptr();
                 auto const send_counts = Base::compute_sorted_send_counts(strptr, arg, level);
                 Base::exchange_and_merge(container, send_counts, arg, builder, comm);
-                this->measuring_tool_.stop("sort_globally", "partial_sorting", comm_root);
-                this->measuring_tool_.setRound(++round);
             }
+        };
 
-            {
-                this->measuring_tool_.start("sort_globally", "final_sorting");
-                // final level of multi-level sort; don't consider distinguishing prefixes
-                sample::NoExtraArg const arg;
-                auto const& comm = comms.comm_final();
-                auto const strptr = container.make_string_lcp_ptr();
-                auto const send_counts = Base::compute_sorted_send_counts(strptr, arg, comm);
-                Base::exchange_and_merge(container, send_counts, arg, builder, comm);
-                this->measuring_tool_.stop("sort_globally", "final_sorting", comm_root);
-                this->measuring_tool_.setRound(0);
+        if constexpr (!Subcommunicators::is_single_level) {
+            for (size_t round = 0; auto const level: comms) {
+                this->measuring_tool_.start("sort_globally", "partial_sorting");
+                sort_level(level, level.comm_exchange);
+                this->measuring_tool_.stop("sort_globally", "partial_sorting", comm_root);
+                this->measuring_tool_.setRound(++round);
             }
-        } else {
-            tlx_die("unreachable for a purely single level implementation");
         }
+
+        this->measuring_tool_.start("sort_globally", "final_sorting");
+        sort_level(comms.comm_final(), comms.comm_final());
+        this->measuring_tool_.stop("sort_globally", "final_sorting", comm_root);
+        this->measuring_tool_.setRound(0);
     }
 
     template <PermutationStringSet StringSet, typename PermutationBuilder>
@@ -209,65 +202,40 @@ protected:
     std::vector<Permutation::RemotePermutation> remote_;
 };
 
-template <
-    AlltoallStringsConfig config,
-    typename RedistributionPolicy,
-    typename PartitionPolicy,
-    typename BloomFilter,
-    typename Permutation>
-class PrefixDoublingMergeSort : private BasePrefixDoublingMergeSort<
-                                    config,
-                                    RedistributionPolicy,
-                                    PartitionPolicy,
-                                    BloomFilter> {
-public:
-    using Base =
-        BasePrefixDoublingMergeSort<config, RedistributionPolicy, PartitionPolicy, BloomFilter>;
-
-    using Base::Base;
-
-    using Subcommunicators = RedistributionPolicy::Subcommunicators;
-
-    template <typename StringSet>
-    Permutation sort(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
-        requires(!has_permutation_members<StringSet>)
-    {
-        this->measuring_tool_.start("augment_container");
-        auto const rank = comms.comm_root().rank();
-        auto augmented_container =
-            augment_string_container<Permutation>(std::move(container), rank);
-        this->measuring_tool_.stop("augment_container");
-
-        return sort(std::move(augmented_container), comms);
-    }
-
-    template <PermutationStringSet StringSet>
-    Permutation sort(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms) {
-        this->measuring_tool_.setPhase("local_sorting");
+namespace _internal {
 
-        auto const strptr = container.make_string_lcp_ptr();
-        this->measuring_tool_.add(container.char_size(), "chars_in_set");
+// Replace the characters of each string by its distinguishing prefix, stored in a new compact
+// array, and release the original characters. LCP values remain valid, since the
+// distinguishing prefix of a string is never shorter than the LCP with its neighbours.
+template <typename StringSet>
+void compact_to_prefixes(
+    StringLcpContainer<StringSet>& container, std::span<size_t const> prefixes
+) {
+    size_t const num_chars = std::accumulate(prefixes.begin(), prefixes.end(), container.size());
 
-        this->measuring_tool_.start("local_sorting", "sort_locally");
-        tlx::sort_strings_detail::radixsort_CI3(strptr, 0, 0);
-        this->measuring_tool_.stop("local_sorting", "sort_locally", comms.comm_root());
+    std::vector<typename StringSet::Char> raw_strings;
+    std::vector<typename StringSet::String> strings;
+    raw_strings.reserve(num_chars);
+    strings.reserve(container.size());
 
-        PermutationBuilder<Permutation> builder{strptr.active()};
+    auto const ss = container.make_string_set();
+    for (size_t i = 0; auto const& str: ss) {
+        auto const chars = ss.get_chars(str, 0);
+        auto const offset = raw_strings.size();
+        raw_strings.insert(raw_strings.end(), chars, chars + prefixes[i]);
+        raw_strings.push_back(0);
 
-        if (comms.comm_root().size() != 1) {
-            auto const prefixes = Base::run_bloom_filter(strptr, comms, start_depth);
-            Base::sort(container, comms, prefixes, builder);
-            this->measuring_tool_.setRound(0);
-        }
-
-        return Base::write_permutation(container.make_string_set(), builder);
+        auto& new_str = strings.emplace_back(str);
+        new_str.string = raw_strings.data() + offset;
+        new_str.length = prefixes[i++];
     }
 
-private:
-    static constexpr size_t start_depth = 8;
-};
-
-namespace _internal {
+    container = StringLcpContainer<StringSet>{
+        std::move(raw_strings),
+        std::move(strings),
+        container.release_lcps()
+    };
+}
 
 template <typename StringSet>
 StringLcpContainer<StringSet> receive_strings(
@@ -345,6 +313,172 @@ StringLcpContainer<StringSet> apply_permutation(
     return output_container;
 }
 
+template <typename Permutation>
+struct NamedPermutation {
+    Permutation permutation;
+    Names names;
+};
+
+template <
+    AlltoallStringsConfig config,
+    typename RedistributionPolicy,
+    typename PartitionPolicy,
+    typename BloomFilter,
+    typename Permutation>
+class PrefixDoublingMergeSort : private BasePrefixDoublingMergeSort<
+                                    config,
+                                    RedistributionPolicy,
+                                    PartitionPolicy,
+                                    BloomFilter> {
+public:
+    using Base =
+        BasePrefixDoublingMergeSort<config, RedistributionPolicy, PartitionPolicy, BloomFilter>;
+
+    using Subcommunicators = RedistributionPolicy::Subcommunicators;
+
+    // With `compact_prefixes`, the input is reduced to its distinguishing prefixes before any
+    // string is exchanged, such that the full input is released before the send buffers exist.
+    explicit PrefixDoublingMergeSort(
+        PartitionPolicy partition,
+        RedistributionPolicy redistribution,
+        local_sort::LocalSorter local_sorter = {},
+        size_t const max_tail_candidates = 0,
+        bool const compact_prefixes = false
+    )
+        : Base{std::move(partition), std::move(redistribution), local_sorter, max_tail_candidates},
+          compact_prefixes_{compact_prefixes} {}
+
+    template <typename StringSet>
+    Permutation sort(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(!has_permutation_members<StringSet>)
+    {
+        this->measuring_tool_.start("augment_container");
+        auto const rank = comms.comm_root().rank();
+        auto augmented_container =
+            augment_string_container<Permutation>(std::move(container), rank);
+        this->measuring_tool_.stop("augment_container");
+
+        return sort(std::move(augmented_container), comms);
+    }
+
+    // Sort the strings and additionally compute the dense rank (name) of each string, in the
+    // same order as the returned permutation. Names are derived from the distinguishing
+    // prefixes, which are only equal for equal strings. Only the simple permutation is stored
+    // in sorted order, hence other permutations are not supported.
+    template <typename StringSet>
+    NamedPermutation<Permutation>
+    sort_named(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(std::is_same_v<Permutation, SimplePermutation>
+                 && !has_permutation_members<StringSet>)
+    {
+        this->measuring_tool_.start("augment_container");
+        auto const rank = comms.comm_root().rank();
+        auto augmented_container =
+            augment_string_container<Permutation>(std::move(container), rank);
+        this->measuring_tool_.stop("augment_container");
+
+        return sort_named(std::move(augmented_container), comms);
+    }
+
+    template <PermutationStringSet StringSet>
+    NamedPermutation<Permutation>
+    sort_named(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(std::is_same_v<Permutation, SimplePermutation>)
+    {
+        auto permutation = sort_(container, comms, container.char_size());
+
+        this->measuring_tool_.start("compute_names");
+        auto const strptr = container.make_string_lcp_ptr();
+        auto names = compute_names(strptr, Base::partition_splits_ties(), comms.comm_root());
+        this->measuring_tool_.stop("compute_names");
+
+        this->measuring_tool_.add(names.num_distinct, "num_distinct");
+        return {std::move(permutation), std::move(names)};
+    }
+
+    template <PermutationStringSet StringSet>
+    Permutation sort(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms) {
+        return sort_(container, comms, container.char_size());
+    }
+
+    // Sort the strings and return the full strings in sorted order. The merge levels only move
+    // distinguishing prefixes and origin indices, afterwards each string is sent directly from
+    // its origin PE to its final PE. Every character is thus sent once, regardless of the
+    // number of levels.
+    template <typename StringSet>
+    StringLcpContainer<StringSet>
+    sort_direct(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(!has_permutation_members<StringSet>
+                 && std::is_same_v<Permutation, SimplePermutation>)
+    {
+        this->measuring_tool_.start("augment_container");
+        auto const rank = comms.comm_root().rank();
+        auto origin_strings = container.get_strings();
+        auto augmented_container =
+            augment_string_container<Permutation>(std::move(container), rank);
+        auto const chars_in_set = augmented_container.char_size();
+
+        // The characters stay with the origin strings until they are delivered. Since the
+        // buffer itself is moved, the augmented strings remain valid until the first exchange.
+        StringContainer<StringSet> origin{
+            augmented_container.release_raw_strings(),
+            std::move(origin_strings)
+        };
+        this->measuring_tool_.stop("augment_container");
+
+        auto const permutation = sort_(augmented_container, comms, chars_in_set);
+
+        this->measuring_tool_.setPhase("deliver_strings");
+        this->measuring_tool_.start("deliver_strings");
+        auto output = apply_permutation(origin.make_string_set(), permutation, comms.comm_root());
+        this->measuring_tool_.stop("deliver_strings");
+
+        // distinguishing prefixes have the same LCPs as the full strings
+        output.set(augmented_container.release_lcps());
+        this->measuring_tool_.setPhase("none");
+        return output;
+    }
+
+private:
+    static constexpr size_t start_depth = 8;
+
+    bool compact_prefixes_;
+
+    // The number of characters is passed explicitly, since `sort_direct` has already moved the
+    // characters out of the container.
+    template <PermutationStringSet StringSet>
+    Permutation sort_(
+        StringLcpContainer<StringSet>& container,
+        Subcommunicators const& comms,
+        size_t const chars_in_set
+    ) {
+        this->measuring_tool_.setPhase("local_sorting");
+
+        auto const strptr = container.make_string_lcp_ptr();
+        this->measuring_tool_.add(chars_in_set, "chars_in_set");
+
+        this->measuring_tool_.start("local_sorting", "sort_locally");
+        this->local_sorter_.sort(strptr);
+        this->measuring_tool_.stop("local_sorting", "sort_locally", comms.comm_root());
+
+        PermutationBuilder<Permutation> builder{strptr.active()};
+
+        if (comms.comm_root().size() != 1) {
+            auto const prefixes = Base::run_bloom_filter(strptr, comms, start_depth);
+            if (compact_prefixes_) {
+                this->measuring_tool_.start("compact_prefixes");
+                _internal::compact_to_prefixes(container, prefixes);
+                this->measuring_tool_.stop("compact_prefixes");
+                this->measuring_tool_.add(container.char_size(), "compact_chars");
+            }
+            Base::sort(container, comms, prefixes, builder);
+            this->measuring_tool_.setRound(0);
+        }
+
+        return Base::write_permutation(container.make_string_set(), builder);
+    }
+};
+
 } // namespace prefix_doubling
 } // namespace sorter
 } // namespace dss_mehnert
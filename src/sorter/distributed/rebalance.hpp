@@ -0,0 +1,215 @@
+// (c) 2023 Pascal Mehnert
+// This code is licensed under BSD 2-Clause License (see LICENSE for details)
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <kamping/collectives/allreduce.hpp>
+#include <kamping/collectives/exscan.hpp>
+#include <kamping/mpi_ops.hpp>
+#include <kamping/named_parameters.hpp>
+#include <tlx/die.hpp>
+
+#include "mpi/communicator.hpp"
+#include "mpi/sparse_alltoall.hpp"
+#include "strings/stringcontainer.hpp"
+#include "strings/stringtools.hpp"
+#include "util/measuringTool.hpp"
+
+namespace dss_mehnert {
+namespace sorter {
+
+enum class RebalanceKind { none, strings, chars };
+
+inline std::string_view get_name(RebalanceKind const kind) {
+    switch (kind) {
+        case RebalanceKind::none:
+            return "none";
+        case RebalanceKind::strings:
+            return "strings";
+        case RebalanceKind::chars:
+            return "chars";
+    }
+    tlx_die("unknown rebalancing kind");
+}
+
+namespace _internal {
+
+// Returns the first global offset assigned to the given PE, i.e. floor(rank * total / p),
+// computed without overflowing.
+inline size_t rebalance_boundary(size_t const rank, size_t const total, size_t const num_pes) {
+    return rank * (total / num_pes) + (rank * (total % num_pes)) / num_pes;
+}
+
+// Assigns each string to the PE whose target range contains the global offset of the string.
+// Returns the number of strings sent to each PE, in increasing order of destination.
+template <typename StringSet, typename Weight>
+std::vector<mpi::MessageCount> compute_rebalance_send_counts(
+    StringSet const& ss, Weight&& weight, Communicator const& comm
+) {
+    size_t local_weight = 0;
+    for (auto const& str: ss) {
+        local_weight += weight(str);
+    }
+
+    size_t const offset = comm.exscan_single(
+        kamping::send_buf(local_weight),
+        kamping::op(kamping::ops::plus<>{})
+    );
+    size_t const total = comm.allreduce_single(
+        kamping::send_buf(local_weight),
+        kamping::op(kamping::ops::plus<>{})
+    );
+
+    std::vector<mpi::MessageCount> send_counts;
+    size_t dest = 0, global_offset = offset;
+    for (auto const& str: ss) {
+        while (dest + 1 < comm.size()
+               && global_offset >= rebalance_boundary(dest + 1, total, comm.size())) {
+            ++dest;
+        }
+        if (send_counts.empty() || send_counts.back().rank != static_cast<int>(dest)) {
+            send_counts.push_back({static_cast<int>(dest), 0});
+        }
+        ++send_counts.back().count;
+        global_offset += weight(str);
+    }
+    return send_counts;
+}
+
+} // namespace _internal
+
+// Redistribute a globally sorted string set such that each PE holds (almost) exactly n / p
+// strings or characters. Since the input is sorted, only strings at the front and back of the
+// local set move, and only to the PEs whose target range overlaps the local range. These are
+// exchanged point-to-point, without any dense collective, and the remaining strings stay in
+// place. Received runs are concatenated in rank order, such that only LCPs at run boundaries
+// change.
+template <typename StringSet>
+void rebalance(
+    StringLcpContainer<StringSet>& container, RebalanceKind const kind, Communicator const& comm
+)
+    requires(StringSet::has_length && !StringSet::is_indexed)
+{
+    using Char = StringSet::Char;
+
+    if (kind == RebalanceKind::none || comm.size() == 1) {
+        return;
+    }
+
+    auto& measuring_tool = measurement::MeasuringTool::measuringTool();
+    measuring_tool.setPhase("rebalancing");
+
+    measuring_tool.start("compute_rebalance_counts");
+    auto const ss = container.make_string_set();
+    auto const send_counts = [&] {
+        if (kind == RebalanceKind::strings) {
+            auto weight = [](auto const&) -> size_t { return 1; };
+            return _internal::compute_rebalance_send_counts(ss, weight, comm);
+        } else {
+            auto weight = [&](auto const& str) -> size_t { return ss.get_length(str) + 1; };
+            return _internal::compute_rebalance_send_counts(ss, weight, comm);
+        }
+    }();
+    measuring_tool.stop("compute_rebalance_counts");
+
+    measuring_tool.start("rebalance_strings");
+    auto const rank = static_cast<int>(comm.rank());
+    auto const append_string = [&](std::vector<Char>& chars, size_t const i) {
+        auto const& str = ss.at(i);
+        auto const begin = ss.get_chars(str, 0);
+        chars.insert(chars.end(), begin, begin + ss.get_length(str));
+        chars.push_back(0);
+    };
+
+    // only the strings leaving this PE are packed, each followed by a null byte
+    std::vector<Char> send_chars;
+    std::vector<size_t> send_lcps;
+    std::vector<mpi::MessageCount> char_counts, string_counts;
+    size_t keep_begin = 0, keep_end = 0;
+    for (size_t i = 0; auto const [dest, count]: send_counts) {
+        auto const end = i + count;
+        if (dest == rank) {
+            keep_begin = i;
+            keep_end = i = end;
+            continue;
+        }
+
+        auto const prev_size = send_chars.size();
+        auto const lcps = container.lcps().begin();
+        send_lcps.insert(send_lcps.end(), lcps + i, lcps + end);
+        for (; i != end; ++i) {
+            append_string(send_chars, i);
+        }
+        char_counts.push_back({dest, static_cast<int>(send_chars.size() - prev_size)});
+        string_counts.push_back({dest, count});
+    }
+
+    std::vector<mpi::MessageCount> recv_char_counts, recv_string_counts;
+    auto const recv_chars =
+        mpi::sparse_alltoallv<Char>(send_chars, char_counts, recv_char_counts, comm);
+    auto const recv_lcps =
+        mpi::sparse_alltoallv<size_t>(send_lcps, string_counts, recv_string_counts, comm);
+    measuring_tool.stop("rebalance_strings");
+
+    measuring_tool.start("repair_lcps");
+    size_t lower_chars = 0, lower_strings = 0;
+    for (auto const [source, count]: recv_char_counts) {
+        lower_chars += source < rank ? count : 0;
+    }
+    for (auto const [source, count]: recv_string_counts) {
+        lower_strings += source < rank ? count : 0;
+    }
+
+    std::vector<Char> raw_strings;
+    raw_strings.reserve(recv_chars.size() + container.char_size());
+    raw_strings.insert(raw_strings.end(), recv_chars.begin(), recv_chars.begin() + lower_chars);
+    for (size_t i = keep_begin; i != keep_end; ++i) {
+        append_string(raw_strings, i);
+    }
+    raw_strings.insert(raw_strings.end(), recv_chars.begin() + lower_chars, recv_chars.end());
+
+    auto const& lcps = container.lcps();
+    std::vector<size_t> new_lcps;
+    new_lcps.reserve(recv_lcps.size() + keep_end - keep_begin);
+    new_lcps.insert(new_lcps.end(), recv_lcps.begin(), recv_lcps.begin() + lower_strings);
+    new_lcps.insert(new_lcps.end(), lcps.begin() + keep_begin, lcps.begin() + keep_end);
+    new_lcps.insert(new_lcps.end(), recv_lcps.begin() + lower_strings, recv_lcps.end());
+
+    // the kept strings form a run between the runs received from lower and higher PEs
+    std::vector<size_t> run_sizes;
+    bool kept_inserted = false;
+    for (auto const [source, count]: recv_string_counts) {
+        if (source > rank && !std::exchange(kept_inserted, true)) {
+            run_sizes.push_back(keep_end - keep_begin);
+        }
+        run_sizes.push_back(count);
+    }
+    if (!kept_inserted) {
+        run_sizes.push_back(keep_end - keep_begin);
+    }
+    container = StringLcpContainer<StringSet>{std::move(raw_strings), std::move(new_lcps)};
+
+    // the LCP at the start of each run is recomputed
+    auto const recv_ss = container.make_string_set();
+    for (size_t offset = 0; auto const count: run_sizes) {
+        if (offset == 0 && count > 0) {
+            container.lcps()[offset] = 0;
+        } else if (count > 0) {
+            auto const& prev = recv_ss.at(offset - 1);
+            auto const& curr = recv_ss.at(offset);
+            container.lcps()[offset] = dss_schimek::calc_lcp(recv_ss, prev, curr);
+        }
+        offset += count;
+    }
+    measuring_tool.stop("repair_lcps");
+
+    measuring_tool.add(container.size(), "local_num_strings");
+}
+
+} // namespace sorter
+} // namespace dss_mehnert
@@ -17,7 +17,6 @@
 #include <utility>
 #include <vector>
 
-#include <ips4o.hpp>
 #include <kamping/collectives/exscan.hpp>
 #include <kamping/named_parameters.hpp>
 #include <tlx/die.hpp>
@@ -27,10 +26,61 @@
 namespace dss_mehnert {
 namespace sample {
 
-inline size_t get_sample_size(
-    size_t const local_size, size_t const num_partitions, size_t const sampling_factor
+// Parameters shared by all sampling policies. If `max_imbalance` is positive, the number of
+// samples is derived from it instead of using the fixed `sampling_factor`.
+struct SamplingConfig {
+    size_t sampling_factor = 2;
+    double max_imbalance = 0.0;
+    uint64_t seed = 3469931;
+};
+
+namespace _internal {
+
+// Number of samples per PE such that no partition exceeds (1 + max_imbalance) * n / k, assuming
+// an evenly distributed input. Regular sampling leaves at most one gap of n / (p * (s + 1))
+// per PE at each partition boundary. Stratified random sampling may leave two gaps, but its
+// sample size can also be bounded using a Chernoff bound (w.h.p.), which grows only with
+// log(k) / eps^2 per partition instead of k / eps per PE.
+template <bool is_random>
+size_t get_targeted_sample_size(
+    size_t const num_partitions, size_t const num_pes, double const max_imbalance
 ) {
-    return std::min(sampling_factor * (num_partitions - 1), local_size);
+    auto const k = static_cast<double>(num_partitions);
+    auto const eps = max_imbalance;
+    if constexpr (is_random) {
+        auto const stratified = std::ceil(2 * k / eps);
+        auto const per_partition = 4 * (1 + eps) * std::log(std::max(k, 2.0)) / (eps * eps);
+        auto const chernoff = std::ceil(per_partition * k / static_cast<double>(num_pes));
+        return static_cast<size_t>(std::min(stratified, chernoff));
+    } else {
+        return static_cast<size_t>(std::ceil(k / eps)) - 1;
+    }
+}
+
+} // namespace _internal
+
+template <bool is_random>
+size_t get_sample_size(
+    size_t const local_size,
+    size_t const num_partitions,
+    SamplingConfig const& config,
+    Communicator const& comm
+) {
+    if (config.max_imbalance > 0.0) {
+        auto const sample_size = _internal::get_targeted_sample_size<is_random>(
+            num_partitions,
+            comm.size(),
+            config.max_imbalance
+        );
+        return std::min(sample_size, local_size);
+    } else {
+        return std::min(config.sampling_factor * (num_partitions - 1), local_size);
+    }
+}
+
+// Every PE draws from an independent stream, such that sample positions are not correlated.
+inline uint64_t get_sampler_seed(SamplingConfig const& config, Communicator const& comm) {
+    return config.seed + comm.rank();
 }
 
 inline size_t get_local_offset(size_t const local_size, Communicator const& comm) {
@@ -113,7 +163,7 @@ class StringIndexSampler<false> {
 public:
     StringIndexSampler() = delete;
 
-    StringIndexSampler(size_t const strings, size_t const samples)
+    StringIndexSampler(size_t const strings, size_t const samples, uint64_t)
         : sample_dist_{static_cast<double>(strings) / static_cast<double>(samples + 1)} {}
 
     size_t get_sample(size_t const index) {
@@ -124,20 +174,27 @@ private:
     double sample_dist_;
 };
 
+// Draws one uniformly random string from each of `samples` equally sized strata.
 template <>
 class StringIndexSampler<true> {
 public:
     StringIndexSampler() = delete;
 
-    StringIndexSampler(size_t const strings, size_t)
-        : gen_{}, // todo what to do about seed here?
-          dist_{0, std::max<size_t>(1, strings) - 1} {}
+    StringIndexSampler(size_t const strings, size_t const samples, uint64_t const seed)
+        : gen_{seed},
+          strings_{strings},
+          samples_{std::max<size_t>(1, samples)} {}
 
-    size_t get_sample(size_t) { return dist_(gen_); }
+    size_t get_sample(size_t const index) {
+        auto const begin = (index - 1) * strings_ / samples_;
+        auto const end = std::max(begin + 1, index * strings_ / samples_);
+        return std::uniform_int_distribution<size_t>{begin, end - 1}(gen_);
+    }
 
 private:
     std::mt19937_64 gen_;
-    std::uniform_int_distribution<size_t> dist_;
+    size_t strings_;
+    size_t samples_;
 };
 
 template <bool is_random>
@@ -148,7 +205,7 @@ class CharIndexSampler<false> {
 public:
     CharIndexSampler() = delete;
 
-    CharIndexSampler(size_t const num_chars, size_t const num_samples)
+    CharIndexSampler(size_t const num_chars, size_t const num_samples, uint64_t)
         : sample_dist_{num_chars / (num_samples + 1)},
           current_boundary_{0} {}
 
@@ -161,25 +218,30 @@ private:
     size_t current_boundary_;
 };
 
+// Draws one uniformly random character from each of `num_samples` equally sized strata,
+// which yields increasing positions without having to sort them.
 template <>
 class CharIndexSampler<true> {
 public:
     CharIndexSampler() = delete;
 
-    CharIndexSampler(size_t const num_chars, size_t const num_samples)
-        : sample_(num_samples),
-          current_{0} {
-        // todo again, what about seed here
-        std::mt19937_64 gen;
-        std::uniform_int_distribution<size_t> dist{0, std::max<size_t>(1, num_chars) - 1};
-        std::generate(sample_.begin(), sample_.end(), [&] { return dist(gen); });
-        ips4o::sort(sample_.begin(), sample_.end());
+    CharIndexSampler(size_t const num_chars, size_t const num_samples, uint64_t const seed)
+        : gen_{seed},
+          num_chars_{num_chars},
+          num_samples_{std::max<size_t>(1, num_samples)},
+          current_{0} {}
+
+    size_t next() {
+        auto const begin = current_ * num_chars_ / num_samples_;
+        auto const end = std::max(begin + 1, ++current_ * num_chars_ / num_samples_);
+        // boundaries are one-based, such that at least one string is always consumed
+        return std::uniform_int_distribution<size_t>{begin + 1, end}(gen_);
     }
 
-    size_t next() { return sample_[current_++]; }
-
 private:
-    std::vector<size_t> sample_;
+    std::mt19937_64 gen_;
+    size_t num_chars_;
+    size_t num_samples_;
     size_t current_;
 };
 
@@ -196,8 +258,9 @@ public:
 
     StringBasedSampling() = default;
 
-    explicit StringBasedSampling(size_t const sampling_factor)
-        : sampling_factor_{sampling_factor} {}
+    explicit StringBasedSampling(size_t const sampling_factor) : config_{sampling_factor} {}
+
+    explicit StringBasedSampling(SamplingConfig const config) : config_{config} {}
 
     template <typename StringSet, typename ExtraArg>
     Result<StringSet> sample_splitters(
@@ -206,9 +269,11 @@ public:
         ExtraArg const arg,
         Communicator const& comm
     ) const {
-        size_t const sample_size = get_sample_size(ss.size(), num_partitions, sampling_factor_);
+        size_t const sample_size =
+            get_sample_size<is_random>(ss.size(), num_partitions, config_, comm);
 
-        _internal::StringIndexSampler<is_random> sampler{ss.size(), sample_size};
+        auto const seed = get_sampler_seed(config_, comm);
+        _internal::StringIndexSampler<is_random> sampler{ss.size(), sample_size, seed};
 
         Result<StringSet> result;
         result.sample.reserve(sample_size * (100 + 1u)); // todo
@@ -235,7 +300,7 @@ public:
     }
 
 private:
-    size_t sampling_factor_;
+    SamplingConfig config_;
 };
 
 template <bool is_indexed_, bool is_random_>
@@ -249,7 +314,9 @@ public:
 
     CharBasedSampling() = default;
 
-    explicit CharBasedSampling(size_t const sampling_factor) : sampling_factor_{sampling_factor} {}
+    explicit CharBasedSampling(size_t const sampling_factor) : config_{sampling_factor} {}
+
+    explicit CharBasedSampling(SamplingConfig const config) : config_{config} {}
 
     template <typename StringSet, typename ExtraArg>
     Result<StringSet> sample_splitters(
@@ -259,9 +326,11 @@ public:
         Communicator const& comm
     ) const {
         size_t const num_chars = accumulate_chars(ss, arg);
-        size_t const sample_size = get_sample_size(ss.size(), num_partitions, sampling_factor_);
+        size_t const sample_size =
+            get_sample_size<is_random>(ss.size(), num_partitions, config_, comm);
 
-        _internal::CharIndexSampler<is_random> sampler{num_chars, sample_size};
+        auto const seed = get_sampler_seed(config_, comm);
+        _internal::CharIndexSampler<is_random> sampler{num_chars, sample_size, seed};
 
         Result<StringSet> result;
         result.sample.reserve((num_chars / std::max<size_t>(1, ss.size()) + 1) * sample_size);
@@ -297,7 +366,7 @@ public:
     }
 
 private:
-    size_t sampling_factor_;
+    SamplingConfig config_;
 };
 
 } // namespace sample
@@ -5,6 +5,9 @@
 
 #include <algorithm>
 #include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
 
 #include <kamping/mpi_datatype.hpp>
 #include <kamping/named_parameters.hpp>
@@ -13,7 +16,6 @@
 #include <kamping/p2p/recv.hpp>
 #include <mpi.h>
 #include <tlx/math/div_ceil.hpp>
-#include <tlx/sort/strings/radix_sort.hpp>
 
 #include "mpi/communicator.hpp"
 #include "mpi/rotate.hpp"
@@ -35,8 +37,15 @@ class PermutationBuilder<CharType, SimplePermutation> {
 public:
     using Permutation = SimplePermutation;
 
+    // quantiles are not batched, since the permutation is computed on the fly
     template <PermutationStringSet StringSet, typename Subcommunicators>
-    PermutationBuilder(StringSet const&, Subcommunicators const&) {}
+    PermutationBuilder(
+        StringSet const&,
+        Subcommunicators const&,
+        size_t const = 1,
+        bool const = true,
+        bool const = false
+    ) {}
 
     template <PermutationStringSet StringSet>
     void reset(StringSet const&) {}
@@ -46,11 +55,13 @@ public:
 
     template <PermutationStringPtr StringPtr, typename Subcommunicators>
     void apply(
-        StringPtr const& strptr, std::span<size_t> global_permutation, Subcommunicators const& comms
+        StringPtr const& strptr,
+        std::span<size_t> global_permutation,
+        Subcommunicators const& comms,
+        bool const = true
     ) {
         Permutation const permutation{strptr.active()};
         permutation.apply(global_permutation, global_offset_, comms);
-
         global_offset_ += comms.comm_root().allreduce_single(
             kamping::send_buf(strptr.size()),
             kamping::op(std::plus<>{})
@@ -67,8 +78,17 @@ public:
     using Permutation = MultiLevelPermutation;
 
     template <PermutationStringSet StringSet, typename Subcommunicators>
-    PermutationBuilder(StringSet const&, Subcommunicators const& comms)
-        : permutation_(std::distance(comms.begin(), comms.end()) + 1) {}
+    PermutationBuilder(
+        StringSet const&,
+        Subcommunicators const& comms,
+        size_t const quantiles_per_batch = 1,
+        bool const = true,
+        bool const compress_indices = false
+    )
+        : depth_(std::distance(comms.begin(), comms.end()) + 1),
+          quantiles_per_batch_{quantiles_per_batch},
+          compress_indices_{compress_indices},
+          permutation_(depth_) {}
 
     template <PermutationStringSet StringSet>
     void reset(StringSet const& ss) {
@@ -82,21 +102,35 @@ public:
             .write(ss, std::vector<int>{counts.begin(), counts.end()});
     }
 
+    // The permutation is only written back once `quantiles_per_batch` quantiles are buffered.
     template <PermutationStringPtr StringPtr, typename Subcommunicators>
     void apply(
-        StringPtr const& strptr, std::span<size_t> global_permutation, Subcommunicators const& comms
+        StringPtr const&,
+        std::span<size_t> global_permutation,
+        Subcommunicators const& comms,
+        bool const is_last = true
     ) {
-        permutation_.apply(global_permutation, global_offset_, comms);
-        global_offset_ += comms.comm_root().allreduce_single(
-            kamping::send_buf(strptr.size()),
-            kamping::op(std::plus<>{})
-        );
+        batch_.push_back(std::exchange(permutation_, Permutation(depth_)));
+        if (is_last || batch_.size() >= quantiles_per_batch_) {
+            global_offset_ = Permutation::apply_batch(
+                batch_,
+                global_permutation,
+                global_offset_,
+                comms,
+                compress_indices_
+            );
+            batch_.clear();
+        }
     }
 
 private:
+    size_t depth_;
+    size_t quantiles_per_batch_;
+    bool compress_indices_;
     size_t current_depth_ = 0;
     size_t global_offset_ = 0;
     MultiLevelPermutation permutation_;
+    std::vector<MultiLevelPermutation> batch_;
 };
 
 template <typename CharType>
@@ -104,9 +138,21 @@ class PermutationBuilder<CharType, NonUniquePermutation> {
 public:
     using Permutation = NonUniquePermutation;
 
+    // If the partitioning never splits equal strings between PEs (or quantiles), the dense
+    // ranks follow from the merge LCPs alone and no boundary strings have to be exchanged.
     template <PermutationStringSet StringSet, typename Subcommunicators>
-    PermutationBuilder(StringSet const& ss, Subcommunicators const& comms)
-        : permutation_(std::distance(comms.begin(), comms.end()) + 1),
+    PermutationBuilder(
+        StringSet const& ss,
+        Subcommunicators const& comms,
+        size_t const quantiles_per_batch = 1,
+        bool const splits_ties = true,
+        bool const compress_indices = false
+    )
+        : depth_(std::distance(comms.begin(), comms.end()) + 1),
+          quantiles_per_batch_{quantiles_per_batch},
+          splits_ties_{splits_ties},
+          compress_indices_{compress_indices},
+          permutation_(depth_),
           lower_bound_{0} {}
 
     template <PermutationStringSet StringSet>
@@ -121,28 +167,43 @@ public:
             .write(ss, std::vector<int>{counts.begin(), counts.end()});
     }
 
+    // The permutation is only written back once `quantiles_per_batch` quantiles are buffered.
     template <PermutationStringPtr StringPtr, typename Subcommunicators>
     void apply(
-        StringPtr const& strptr, std::span<size_t> global_permutation, Subcommunicators const& comms
+        StringPtr const& strptr,
+        std::span<size_t> global_permutation,
+        Subcommunicators const& comms,
+        bool const is_last = true
     ) {
         write_offsets(strptr, comms.comm_root());
-        permutation_.apply(global_permutation, global_offset_, comms);
-
-        auto const& offsets = permutation_.index_offsets();
-        // todo this is being computed/communicated redundantly multiple times
-        auto const local_offset_sum = std::accumulate(offsets.begin(), offsets.end(), size_t{0});
-        global_offset_ += comms.comm_root().allreduce_single(
-            kamping::send_buf(local_offset_sum),
-            kamping::op(std::plus<>{})
-        );
         is_first_quantile_ = false;
+
+        batch_.push_back(std::exchange(permutation_, Permutation(depth_)));
+        if (is_last || batch_.size() >= quantiles_per_batch_) {
+            global_offset_ = Permutation::apply_batch(
+                batch_,
+                global_permutation,
+                global_offset_,
+                comms,
+                compress_indices_
+            );
+            batch_.clear();
+        }
     }
 
+    // Number of distinct strings in all quantiles written so far (assuming a non-empty input).
+    size_t num_distinct() const { return global_offset_ + 1; }
+
 private:
+    size_t depth_;
+    size_t quantiles_per_batch_;
+    bool splits_ties_;
+    bool compress_indices_;
     bool is_first_quantile_ = true;
     size_t current_depth_ = 0;
     size_t global_offset_ = 0;
     NonUniquePermutation permutation_;
+    std::vector<NonUniquePermutation> batch_;
     std::vector<CharType> lower_bound_;
 
     template <PermutationStringPtr StringPtr>
@@ -157,6 +218,11 @@ private:
         auto& index_offsets = permutation_.index_offsets();
         index_offsets.resize(strptr.size());
 
+        if (!splits_ties_) {
+            write_offsets_unsplit(strptr, comm);
+            return;
+        }
+
         // compare first string on PE 0 to last string of previous quantile
         if (!is_first_quantile_ && comm.rank() == 0 && !ss.empty()) {
             index_offsets.front() = !is_equal(lower_bound_, *ss.begin());
@@ -188,7 +254,35 @@ private:
             index_offsets.front() = !is_equal(lower_bound_, *ss.begin());
         }
 
-        // compare local strings using LCP values
+        write_local_offsets(strptr);
+    }
+
+    // Equal strings are never split between PEs or quantiles, hence the first string on each
+    // PE always starts a new rank, except for the very first string overall.
+    template <PermutationStringPtr StringPtr>
+    void write_offsets_unsplit(StringPtr const& strptr, Communicator const& comm) {
+        auto const& ss = strptr.active();
+
+        size_t first_non_empty_rank = comm.size();
+        if (is_first_quantile_) {
+            first_non_empty_rank = comm.allreduce_single(
+                kamping::send_buf(ss.empty() ? comm.size() : comm.rank()),
+                kamping::op(kamping::ops::min<>{})
+            );
+        }
+
+        if (!ss.empty()) {
+            permutation_.index_offsets().front() = comm.rank() != first_non_empty_rank;
+        }
+        write_local_offsets(strptr);
+    }
+
+    // compare local strings using the LCP values of the final merge
+    template <PermutationStringPtr StringPtr>
+    void write_local_offsets(StringPtr const& strptr) {
+        auto const& ss = strptr.active();
+        auto& index_offsets = permutation_.index_offsets();
+
         if (size_t i = 1; !ss.empty()) {
             for (auto it = ss.begin() + 1; it != ss.end(); ++i, ++it) {
                 index_offsets[i] = (strptr.get_lcp(i) != ss[it].length);
@@ -278,6 +372,13 @@ private:
     static constexpr size_t start_depth = 8;
 };
 
+// Inverse permutation of a single quantile, where `global_offset` is the global rank of the
+// first string of the quantile.
+struct InverseQuantile {
+    SimplePermutation permutation;
+    size_t global_offset;
+};
+
 // this struct is required to disambiguate the PartitionPolicy used
 // in sorting and the one use to compute quantiles
 template <typename PartitionPolicy>
@@ -292,11 +393,15 @@ public:
     SpaceEfficientSort(
         BloomFilterPolicy bloom_filter,
         QuantilePolicy quantile_partition,
-        size_t const quantile_size
+        size_t const quantile_size,
+        size_t const permutation_batch_memory = 0,
+        bool const compress_permutation = false
     )
         : QuantilePolicy_{std::move(quantile_partition)},
           BloomFilterPolicy{std::move(bloom_filter)},
-          quantile_size_{quantile_size} {}
+          quantile_size_{quantile_size},
+          permutation_batch_memory_{permutation_batch_memory},
+          compress_permutation_{compress_permutation} {}
 
     template <typename StringSet>
     std::vector<size_t>
@@ -315,6 +420,97 @@ public:
     template <PermutationStringSet StringSet>
     std::vector<size_t>
     sort(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms) {
+        std::vector<size_t> global_permutation(container.size());
+
+        auto write_local = [&](auto const& strptr) {
+            auto const& ss = strptr.active();
+            for (size_t i = 0, rank = 0; auto const& str: ss) {
+                // equal strings receive equal (dense) ranks for non-unique permutations
+                if constexpr (!Permutation::is_unique) {
+                    rank += i > 0 && strptr.get_lcp(i) != ss.get_length(str);
+                    num_distinct_ = rank + 1;
+                } else {
+                    rank = i;
+                }
+                global_permutation[str.getStringIndex()] = rank;
+                ++i;
+            }
+        };
+        auto write_quantile = [&](auto& builder, auto const& sorted_ptr, bool const is_last) {
+            builder.apply(sorted_ptr, global_permutation, comms, is_last);
+            if constexpr (!Permutation::is_unique) {
+                num_distinct_ = builder.num_distinct();
+            }
+        };
+        sort_quantiles(container, comms, write_local, write_quantile);
+
+        return global_permutation;
+    }
+
+    // Sort the strings, but leave the permutation in sorted order at the destination PEs,
+    // i.e. for each quantile, each PE holds the origin PE and index for a consecutive range
+    // of global ranks. This skips routing the global ranks back to the origin of each string.
+    template <typename StringSet>
+    std::vector<InverseQuantile>
+    sort_inverse(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(std::is_same_v<Permutation, SimplePermutation>
+                 && !has_permutation_members<StringSet>)
+    {
+        this->measuring_tool_.start("augment_container");
+        auto const rank = comms.comm_root().rank();
+        auto augmented_container =
+            augment_string_container<Permutation>(std::move(container), rank);
+        this->measuring_tool_.stop("augment_container");
+
+        return sort_inverse(std::move(augmented_container), comms);
+    }
+
+    template <PermutationStringSet StringSet>
+    std::vector<InverseQuantile>
+    sort_inverse(StringLcpContainer<StringSet>&& container, Subcommunicators const& comms)
+        requires(std::is_same_v<Permutation, SimplePermutation>)
+    {
+        std::vector<InverseQuantile> quantiles;
+        size_t global_offset = 0;
+
+        auto write_local = [&](auto const& strptr) {
+            quantiles.push_back({SimplePermutation{strptr.active()}, 0});
+        };
+        auto write_quantile = [&](auto&, auto const& sorted_ptr, bool) {
+            quantiles.push_back({SimplePermutation{sorted_ptr.active()}, global_offset});
+            global_offset += comms.comm_root().allreduce_single(
+                kamping::send_buf(sorted_ptr.size()),
+                kamping::op(std::plus<>{})
+            );
+        };
+        sort_quantiles(container, comms, write_local, write_quantile);
+
+        return quantiles;
+    }
+
+    // Number of distinct strings seen by the last call to `sort`, i.e. the largest dense rank
+    // plus one. Only available for non-unique permutations.
+    size_t num_distinct() const
+        requires(!Permutation::is_unique)
+    {
+        return num_distinct_;
+    }
+
+private:
+    static constexpr size_t start_depth = 8;
+
+    size_t quantile_size_;
+    size_t permutation_batch_memory_;
+    bool compress_permutation_;
+    size_t num_distinct_ = 0;
+
+    template <PermutationStringSet StringSet, typename WriteLocal, typename WriteQuantile>
+    void sort_quantiles(
+        StringLcpContainer<StringSet>& container,
+        Subcommunicators const& comms,
+        WriteLocal&& write_local,
+        WriteQuantile&& write_quantile
+    ) {
         using Char = StringSet::Char;
         auto const strptr = container.make_string_lcp_ptr();
         auto const& comm_root = comms.comm_root();
@@ -323,20 +519,16 @@ public:
         this->measuring_tool_.add(container.char_size(), "chars_in_set");
 
         this->measuring_tool_.start("local_sorting", "sort_locally");
-        tlx::sort_strings_detail::radixsort_CI3(strptr, 0, 500 * 1024 * 1024);
+        this->local_sorter_.sort(strptr);
         this->measuring_tool_.stop("local_sorting", "sort_locally", comm_root);
 
-        std::vector<size_t> global_permutation(strptr.size());
-
         if (comm_root.size() == 1) {
             this->measuring_tool_.start("sort_globally", "write_global_permutation");
-            for (size_t i = 0; auto const& str: strptr.active()) {
-                global_permutation[str.getStringIndex()] = i++;
-            }
+            write_local(strptr);
             this->measuring_tool_.stop("sort_globally", "write_global_permutation");
 
             this->measuring_tool_.setPhase("none");
-            return global_permutation;
+            return;
         }
 
         auto const state = BloomFilterPolicy::init(strptr, comms);
@@ -347,7 +539,15 @@ public:
 
         this->measuring_tool_.start("sort_quantiles", "sort_quantiles_overall");
 
-        PermutationBuilder<Char, Permutation> builder{strptr.active(), comms};
+        size_t const quantiles_per_batch = compute_quantiles_per_batch(quantile_sizes, comms);
+        bool const splits_ties =
+            QuantilePolicy_::splits_ties() || BloomFilterPolicy::partition_splits_ties();
+        PermutationBuilder<Char, Permutation> builder{
+            strptr.active(),
+            comms,
+            quantiles_per_batch,
+            splits_ties,
+            compress_permutation_};
 
         for (size_t i = 0, local_offset = 0; i != quantile_sizes.size(); ++i) {
             this->measuring_tool_.setQuantile(i);
@@ -377,7 +577,8 @@ public:
 
             this->measuring_tool_.start("sort_globally", "write_global_permutation");
             auto const sorted_ptr = quantile_container.make_string_lcp_ptr();
-            builder.apply(sorted_ptr, global_permutation, comms);
+            bool const is_last = i + 1 == quantile_sizes.size();
+            write_quantile(builder, sorted_ptr, is_last);
             this->measuring_tool_.stop("sort_globally", "write_global_permutation");
             this->measuring_tool_.stop("sort_globally", "quantile_overall");
 
@@ -386,14 +587,32 @@ public:
 
         this->measuring_tool_.setQuantile(0);
         this->measuring_tool_.stop("sort_quantiles", "sort_quantiles_overall");
-
-        return global_permutation;
     }
 
-private:
-    static constexpr size_t start_depth = 8;
+    // Number of quantiles whose permutations are buffered before being written back, such that
+    // the buffered permutations roughly fit into the configured memory budget.
+    size_t compute_quantiles_per_batch(
+        std::vector<size_t> const& quantile_sizes, Subcommunicators const& comms
+    ) {
+        if (permutation_batch_memory_ == 0) {
+            return 1;
+        }
 
-    size_t quantile_size_;
+        size_t const num_levels = std::distance(comms.begin(), comms.end()) + 1;
+        size_t const bytes_per_string = sizeof(size_t) + num_levels * sizeof(int);
+
+        auto const max_it = std::max_element(quantile_sizes.begin(), quantile_sizes.end());
+        size_t const local_max = max_it == quantile_sizes.end() ? 0 : *max_it;
+        size_t const global_max = comms.comm_root().allreduce_single(
+            kamping::send_buf(local_max),
+            kamping::op(kamping::ops::max<>{})
+        );
+
+        size_t const bytes_per_quantile = std::max<size_t>(1, global_max * bytes_per_string);
+        size_t const quantiles_per_batch = permutation_batch_memory_ / bytes_per_quantile;
+        this->measuring_tool_.add(quantiles_per_batch, "quantiles_per_batch");
+        return std::max<size_t>(1, quantiles_per_batch);
+    }
 
     template <typename StringPtr, typename ExtraArg>
     std::vector<size_t>
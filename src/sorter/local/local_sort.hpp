@@ -0,0 +1,269 @@
+// (c) 2023 Pascal Mehnert
+// This code is licensed under BSD 2-Clause License (see LICENSE for details)
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/sort/strings/multikey_quicksort.hpp>
+#include <tlx/sort/strings/parallel_sample_sort.hpp>
+#include <tlx/sort/strings/radix_sort.hpp>
+#include <tlx/sort/strings/string_ptr.hpp>
+
+#include "merge/lcp_merge.hpp"
+#include "strings/stringtools.hpp"
+
+namespace dss_mehnert {
+namespace local_sort {
+
+enum class LocalSortKind { radix_sort, multikey_quicksort, lcp_merge_sort, parallel_sample_sort };
+
+inline std::string_view get_name(LocalSortKind const kind) {
+    switch (kind) {
+        case LocalSortKind::radix_sort:
+            return "radix_sort";
+        case LocalSortKind::multikey_quicksort:
+            return "multikey_quicksort";
+        case LocalSortKind::lcp_merge_sort:
+            return "lcp_merge_sort";
+        case LocalSortKind::parallel_sample_sort:
+            return "parallel_sample_sort";
+    }
+    tlx_die("unknown local sorter");
+}
+
+// Compute the LCP array of an already sorted string set with a single linear scan.
+template <typename StringLcpPtr>
+void compute_lcps(StringLcpPtr const& strptr) {
+    auto const& ss = strptr.active();
+    if (ss.empty()) {
+        return;
+    }
+
+    strptr.set_lcp(0, 0);
+    for (size_t i = 1; i != ss.size(); ++i) {
+        strptr.set_lcp(i, dss_schimek::calc_lcp(ss, ss.at(i - 1), ss.at(i)));
+    }
+}
+
+namespace _internal {
+
+template <typename StringLcpPtr>
+void lcp_merge_sort(StringLcpPtr const& strptr, StringLcpPtr const& tmp) {
+    // radix sort switches to insertion sort for inputs of this size
+    constexpr size_t base_case_size = 64;
+
+    if (strptr.size() <= base_case_size) {
+        tlx::sort_strings_detail::radixsort_CI3(strptr, 0, 0);
+        strptr.set_lcp(0, 0);
+        return;
+    }
+
+    size_t const mid = strptr.size() / 2, rest = strptr.size() - mid;
+    lcp_merge_sort(strptr.sub(0, mid), tmp.sub(0, mid));
+    lcp_merge_sort(strptr.sub(mid, rest), tmp.sub(mid, rest));
+
+    auto const& ss = strptr.active();
+    std::copy(ss.begin(), ss.end(), tmp.active().begin());
+    std::copy_n(strptr.lcp(), strptr.size(), tmp.lcp());
+    merge::lcp_merge(tmp.sub(0, mid), tmp.sub(mid, rest), strptr);
+}
+
+} // namespace _internal
+
+// Top-down LCP merge sort using binary LCP merging, requires a temporary copy of the string array.
+template <typename StringLcpPtr>
+void lcp_merge_sort(StringLcpPtr const& strptr) {
+    using StringSet = StringLcpPtr::StringSet;
+
+    if (strptr.size() <= 1) {
+        compute_lcps(strptr);
+        return;
+    }
+
+    std::vector<typename StringSet::String> tmp_strings(strptr.size());
+    std::vector<typename StringLcpPtr::LcpType> tmp_lcps(strptr.size());
+    StringSet const tmp_set{tmp_strings.data(), tmp_strings.data() + tmp_strings.size()};
+    _internal::lcp_merge_sort(strptr, StringLcpPtr{tmp_set, tmp_lcps.data()});
+}
+
+// Like `tlx::parallel_sample_sort`, but with a fixed number of threads instead of one thread
+// per hardware thread.
+template <typename StringLcpPtr>
+void parallel_sample_sort(StringLcpPtr const& strptr, size_t const num_threads) {
+    namespace tss = tlx::sort_strings_detail;
+
+    tss::PS5Context<tss::PS5ParametersDefault> ctx{num_threads};
+    ctx.total_size = strptr.size();
+    ctx.rest_size = strptr.size();
+    ctx.num_threads = num_threads;
+
+    ctx.enqueue(/* pstep */ nullptr, strptr, 0);
+    ctx.threads_.loop_until_empty();
+}
+
+class LocalSorter {
+public:
+    LocalSorter() = default;
+
+    // Parallel sample sort uses `num_threads` threads, which defaults to one, since all
+    // PEs on a node would otherwise start one thread per hardware thread each.
+    explicit LocalSorter(
+        LocalSortKind const kind,
+        size_t const memory = 0,
+        bool const detect_presorted = false,
+        size_t const num_threads = 1
+    )
+        : kind_{kind},
+          memory_{memory},
+          detect_presorted_{detect_presorted},
+          num_threads_{std::max<size_t>(num_threads, 1)} {}
+
+    LocalSortKind kind() const { return kind_; }
+    size_t memory() const { return memory_; }
+    bool detect_presorted() const { return detect_presorted_; }
+    size_t num_threads() const { return num_threads_; }
+    std::string_view get_name() const { return local_sort::get_name(kind_); }
+
+    // Sort the given strings and write the corresponding LCP array.
+    // Returns true if the input was detected to be sorted already.
+    template <typename StringLcpPtr>
+    bool sort(StringLcpPtr const& strptr) const {
+        static_assert(StringLcpPtr::with_lcp, "local sorting requires an LCP array");
+
+        if (detect_presorted_) {
+            switch (sort_presorted(strptr)) {
+                case Presortedness::sorted:
+                    return true;
+                case Presortedness::nearly_sorted:
+                    return false;
+                case Presortedness::unsorted:
+                    break;
+            }
+        }
+        sort_(strptr);
+        return false;
+    }
+
+private:
+    // maximum fraction (1 / x) of out-of-order strings for which merging is used
+    static constexpr size_t max_unsorted_divisor = 4;
+
+    enum class Presortedness { sorted, nearly_sorted, unsorted };
+
+    LocalSortKind kind_ = LocalSortKind::radix_sort;
+    size_t memory_ = 0;
+    bool detect_presorted_ = false;
+    size_t num_threads_ = 1;
+
+    template <typename StringLcpPtr>
+    void sort_(StringLcpPtr const& strptr) const {
+        namespace tss = tlx::sort_strings_detail;
+
+        switch (kind_) {
+            case LocalSortKind::radix_sort: {
+                tss::radixsort_CI3(strptr, 0, memory_);
+                return;
+            }
+            case LocalSortKind::multikey_quicksort: {
+                // multikey quicksort does not produce LCP values
+                using StringPtr = tss::StringPtr<typename StringLcpPtr::StringSet>;
+                tss::multikey_quicksort(StringPtr{strptr.active()}, 0, memory_);
+                compute_lcps(strptr);
+                return;
+            }
+            case LocalSortKind::lcp_merge_sort: {
+                lcp_merge_sort(strptr);
+                return;
+            }
+            case LocalSortKind::parallel_sample_sort: {
+                parallel_sample_sort(strptr, num_threads_);
+                return;
+            }
+        }
+        tlx_die("unknown local sorter");
+    }
+
+    // Greedily extract a sorted subsequence (computing its LCPs along the way), then sort the
+    // remaining strings and merge both runs. Bails out if too many strings are out of order.
+    // If a string is smaller than its predecessor but not smaller than the one before that,
+    // the predecessor is treated as outlier instead, such that a single large string does not
+    // cause all following strings to be moved out of the sorted run.
+    template <typename StringLcpPtr>
+    Presortedness sort_presorted(StringLcpPtr const& strptr) const {
+        using StringSet = StringLcpPtr::StringSet;
+
+        auto const& ss = strptr.active();
+        if (ss.size() <= 1) {
+            compute_lcps(strptr);
+            return Presortedness::sorted;
+        }
+
+        size_t const max_unsorted = ss.size() / max_unsorted_divisor;
+        std::vector<typename StringSet::String> unsorted;
+
+        strptr.set_lcp(0, 0);
+        auto dest = ss.begin() + 1;
+        for (auto it = ss.begin() + 1; it != ss.end(); ++it) {
+            auto const& prev = ss[dest - 1];
+            auto const& curr = ss[it];
+
+            auto const lcp = dss_schimek::calc_lcp(ss, prev, curr);
+            auto const prev_chars = ss.get_chars(prev, lcp);
+            auto const curr_chars = ss.get_chars(curr, lcp);
+            if (ss.is_leq(prev, prev_chars, curr, curr_chars)) {
+                strptr.set_lcp(dest - ss.begin(), lcp);
+                ss[dest++] = curr;
+            } else if (unsorted.size() < max_unsorted) {
+                if (dest - 1 == ss.begin()) {
+                    unsorted.push_back(prev);
+                    ss[dest - 1] = curr;
+                    continue;
+                }
+
+                auto const& prev_prev = ss[dest - 2];
+                auto const prev_lcp = dss_schimek::calc_lcp(ss, prev_prev, curr);
+                auto const prev_prev_chars = ss.get_chars(prev_prev, prev_lcp);
+                auto const curr_prev_chars = ss.get_chars(curr, prev_lcp);
+                if (ss.is_leq(prev_prev, prev_prev_chars, curr, curr_prev_chars)) {
+                    unsorted.push_back(prev);
+                    strptr.set_lcp(dest - 1 - ss.begin(), prev_lcp);
+                    ss[dest - 1] = curr;
+                } else {
+                    unsorted.push_back(curr);
+                }
+            } else {
+                // the gap before `it` has exactly the size of the outliers
+                std::copy(unsorted.begin(), unsorted.end(), dest);
+                return Presortedness::unsorted;
+            }
+        }
+
+        if (unsorted.empty()) {
+            return Presortedness::sorted;
+        }
+
+        size_t const num_sorted = dest - ss.begin();
+        std::copy(unsorted.begin(), unsorted.end(), dest);
+        sort_(strptr.sub(num_sorted, unsorted.size()));
+
+        std::vector<typename StringSet::String> tmp_strings(ss.begin(), ss.end());
+        std::vector<typename StringLcpPtr::LcpType> tmp_lcps(
+            strptr.lcp(),
+            strptr.lcp() + ss.size()
+        );
+        StringLcpPtr const tmp{
+            StringSet{tmp_strings.data(), tmp_strings.data() + tmp_strings.size()},
+            tmp_lcps.data()
+        };
+        merge::lcp_merge(tmp.sub(0, num_sorted), tmp.sub(num_sorted, unsorted.size()), strptr);
+        return Presortedness::nearly_sorted;
+    }
+};
+
+} // namespace local_sort
+} // namespace dss_mehnert